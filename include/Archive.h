@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Input_source.h"
+#include <string>
+#include <vector>
+
+// Members of an ar archive (static library), GNU and BSD name variants.
+// The symbol index and the long name table are not members.
+class Archive {
+public:
+    struct Member {
+        std::string name;
+        // Bytes of the member in the archive
+        size_t offset;
+        size_t size;
+    };
+
+    static bool is_archive(Input_source& source);
+    // Reads the whole input, throws std::runtime_error on a broken header
+    Archive(Input_source& source);
+
+    const std::vector<Member>& members() const;
+
+private:
+    std::vector<Member> members_;
+};
@@ -1,6 +1,16 @@
 #pragma once
 
-#include "Elf_parser.h"
+#include "Loader.h"
+#include "Cycle_model.h"
+#include "Isa.h"
+#include "Line_table.h"
+#include "Peephole.h"
+#include "Profile.h"
+#include "Register_usage.h"
+#include "Render_cache.h"
+#include "Source_pool.h"
+#include "Symbol_index.h"
+#include <atomic>
 #include <vector>
 #include <string>
 #include <map>
@@ -8,50 +18,144 @@
 
 class Cmd_parser {
 public:
-    Cmd_parser(Elf_parser& elf_file);
+    // Commands [first, last) of a sized symbol starting in .text
+    struct Function_range {
+        std::string name;
+        Elf32_Addr  start;
+        size_t      first;
+        size_t      last;
+    };
+
+    Cmd_parser(Loader& loader);
+    Cmd_parser();
     std::vector<std::string> parse_cmds();
+    // Decodes single command located at addr
+    std::string parse_cmd(Elf32_Word cmd, Elf32_Addr addr);
+    // Appends "# <func+0x<offset>>" to every command inside a known symbol
+    void annotate_lines(bool enable);
+    // Prints nop, mv, li, ret, j, call, tail and la instead of the commands
+    // they stand for and resolves addresses built with lui/auipc
+    void pseudo_instructions(bool enable);
+    // Prefixes commands with their share of samples and function headers
+    // with sample totals of the whole function. profile must be joined.
+    void set_profile(const Profile *profile);
+    // Precedes commands with the source lines the line table puts at their
+    // addresses, texts come from sources
+    void set_source_lines(const Line_table *lines, Source_pool *sources);
+    // Precedes every basic block with its cycle estimate under model and
+    // ends function headers with the function total. collect_labels()
+    // makes the estimates for its ranges only, so a function cut by them
+    // totals the commands inside.
+    void set_cycle_model(const Cycle_model *model);
+
+    // Listing is rendered in two steps: collect_labels() once, then
+    // render_lines() for any ranges of commands from any number of threads
+    void collect_labels();
+    // Only commands of ranges [first, last) are going to be rendered, so only
+    // their targets need labels; the rest of .text is not decoded at all
+    void collect_labels(const std::vector<std::pair<size_t, size_t>>& ranges);
+    size_t cmds_count() const;
+    // Index of the first command at or after addr, cmds_count() if none
+    size_t cmd_index(Elf32_Addr addr) const;
+    void render_lines(size_t first, size_t last, std::string& out) const;
+    // Appends line of the command at addr without label and pseudo-instruction,
+    // returns false if addr is not a command of .text
+    bool render_trace_line(Elf32_Addr addr, std::string& out) const;
+    // Commands rendered through the word to text cache so far, all threads
+    uint64_t render_cache_lookups() const;
+    uint64_t render_cache_hits() const;
+    // Command ranges [first, last) of at most count functions in .text with
+    // the most samples, hottest first
+    std::vector<std::pair<size_t, size_t>> hottest_functions(size_t count) const;
+    // STT_FUNC symbols of .text by address
+    std::vector<Function_range> functions() const;
+
+    // Linear pass over commands [first, last) split into basic blocks
+    Register_usage register_usage(size_t first, size_t last) const;
+    // Appends "<addr> <name>:" and register sets of the function
+    void render_register_usage(const Function_range& function, std::string& out) const;
 
 private:
-    Elf_parser& elf_file_;
+    Loader* loader_;
     std::map<Elf32_Word, std::string> symtab_;
-    Elf32_Addr cur_addr_ptr_;
+    // Sized symbols of .text; symbols of other sections by section, which
+    // overlap in relocatable objects where every section starts at 0
+    Symbol_index symbols_;
+    std::map<Elf32_Half, Symbol_index> data_symbols_;
+    // Commands of the loader, not copied
+    const Elf32_Word *text_;
+    size_t text_size_;
+    Elf32_Addr text_start_addr_;
     Elf32_Word L_label_counter_;
+    bool annotate_lines_;
+    bool pseudo_instructions_;
+    const Profile *profile_;
+    const Line_table *lines_;
+    Source_pool *sources_;
+    const Cycle_model *cycle_model_;
+    // Commands [first, last) with estimates, sorted and apart from each other.
+    // cumulative_cycles_[base + i - first] is the estimate of the range
+    // commands before command i, for i up to last.
+    struct Cycle_range {
+        size_t first;
+        size_t last;
+        size_t base;
+    };
+    std::vector<Cycle_range> cycle_ranges_;
+    std::vector<uint64_t> cumulative_cycles_;
+    // First commands of basic blocks, each range ends with its last
+    std::vector<size_t> block_bounds_;
+    mutable std::atomic<uint64_t> cache_lookups_;
+    mutable std::atomic<uint64_t> cache_hits_;
+    // Relocations of .text by offset, empty for linked images
+    std::vector<Relocation> relocations_;
+    // Commands control can jump to: symbols, labels and branch targets
+    std::vector<bool> block_starts_;
 
-    bool get_bit(Elf32_Word value, size_t pos);
-    void set_bit(Elf32_Word& dst, size_t pos, bool bit);
-    void write_bits(Elf32_Word src, size_t start, size_t end, Elf32_Word& dst, size_t pos);
-    Elf32_Word read_bits_unsigned(Elf32_Word src, size_t start, size_t end);
-    Elf32_Word get_opcode(Elf32_Word src);
-    std::string parse_cmd(Elf32_Word cmd);
-    std::pair<std::string, std::string> get_succ_pred(Elf32_Word cmd);
-
-    std::string parse_R_type(Elf32_Word cmd);
-    std::string parse_S_type(Elf32_Word cmd);
-    std::string parse_U_type(Elf32_Word cmd);
-    std::string parse_J_type(Elf32_Word cmd);
-    std::string parse_B_type(Elf32_Word cmd);
-    std::string parse_I_type(Elf32_Word cmd);
-    std::string parse_Fence(Elf32_Word cmd);
-
+    bool get_bit(Elf32_Word value, size_t pos) const;
+    Elf32_Word read_bits_unsigned(Elf32_Word src, size_t start, size_t end) const;
+    void collect_labels(Elf32_Word cmd, Elf32_Addr addr);
+    void render_cmd(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr, const Relocation *relocation,
+                    std::string& out) const;
+    void render_uncached_cmd(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr, const Relocation *relocation,
+                             std::string& out) const;
+    void render_line(size_t idx, const Isa_cmd *isa_cmd, const Pseudo& pseudo, const Relocation *relocation,
+                     std::string& out) const;
+    void render_label(const std::string& label, Elf32_Addr addr, std::string& out) const;
+    void render_source_line(const Line_table::Row& row, std::string& out) const;
+    void append_samples(uint64_t count, std::string& out) const;
+    void render_pseudo(const Pseudo& pseudo, const Relocation *relocation, std::string& out) const;
+    void append_relocation(const Relocation& relocation, std::string& out) const;
+    void append_mnemonic(const char *name, const char *suffix, std::string& out) const;
+    void append_address(Elf32_Addr addr, std::string& out) const;
+    void append_registers(uint32_t registers, std::string& out) const;
+    void estimate_cycles(std::vector<std::pair<size_t, size_t>> ranges);
+    void estimate_cycles(const Cycle_range& range, const Isa_cmd *isa_jalr);
+    // Estimate of the commands of cycle_ranges_ before command idx
+    uint64_t cycles_before(size_t idx) const;
+    void render_block_cycles(size_t block, std::string& out) const;
+    void mark_block_start(Elf32_Addr addr);
+    bool is_block_start(size_t idx) const;
+    size_t lower_relocation(size_t idx) const;
+    void render_operand(char op, Elf32_Word cmd, Elf32_Addr addr, const Relocation *relocation,
+                        std::string& out) const;
 
     std::string get_label_name(Elf32_Addr addr);
+    void append_target(Elf32_Addr addr, std::string& out) const;
+    void add_to_index(const Elf32_Sym& symbol, const char *name);
+    bool append_data_location(Elf32_Addr addr, std::string& out) const;
+    std::string get_fence_set(Elf32_Word set) const;
+
+    Elf32_Word read_rd(Elf32_Word cmd) const;
+    Elf32_Word read_rs1(Elf32_Word cmd) const;
+    Elf32_Word read_rs2(Elf32_Word cmd) const;
+    Elf32_Word read_rs3(Elf32_Word cmd) const;
+    Elf32_Word read_funct3(Elf32_Word cmd) const;
+    Elf32_Word read_csr(Elf32_Word cmd) const;
+    Elf32_Word read_fence_pred(Elf32_Word cmd) const;
+    Elf32_Word read_fence_succ(Elf32_Word cmd) const;
 
-    Elf32_Word read_rd(Elf32_Word cmd);
-    Elf32_Word read_rs1(Elf32_Word cmd);
-    Elf32_Word read_rs2(Elf32_Word cmd);
-    Elf32_Word read_funct3(Elf32_Word cmd);
-    Elf32_Word read_funct2(Elf32_Word cmd);
-    Elf32_Word read_funct5(Elf32_Word cmd);
-    Elf32_Word read_fence_bits(Elf32_Word cmd);
-    Elf32_Word read_fence_fm(Elf32_Word cmd);
-    Elf32_Word read_fence_pred(Elf32_Word cmd);
-    Elf32_Word read_fence_succ(Elf32_Word cmd);
-
-    std::string get_cmd_name_R_type(Elf32_Word funct3, Elf32_Word funct2, Elf32_Word funct5);
-    std::string get_cmd_name_S_type(Elf32_Word funct3);
-    std::string get_cmd_name_B_type(Elf32_Word funct3);
-    std::string get_cmd_name_I_type(Elf32_Word opcode, Elf32_Word funct3, Elf32_Word funct5);
-    std::string get_cmd_name_U_type(Elf32_Word opcode);
-
-    std::string get_register(Elf32_Word reg);
+    const char* get_register(Elf32_Word reg) const;
+    const char* get_fp_register(Elf32_Word reg) const;
+    std::string get_csr_name(Elf32_Word csr) const;
 };
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Isa.h"
+#include <cstdint>
+#include <string>
+
+// Cycles of commands of an in-order core by command class.
+// Config file has one "<class> <cycles>" per line, classes left out keep
+// their defaults; empty lines and text after '#' are skipped. Classes:
+//   alu, load, store, mul, div, atomic, fpu, fdiv, csr, system,
+//   branch, jump      issue cycles of control transfers
+//   branch_penalty    added to every branch and jump, taken or not
+//   load_use          stall of a command reading the register loaded by
+//                     the command before it
+class Cycle_model {
+public:
+    // Defaults of a 5-stage RV32IM pipeline
+    Cycle_model();
+    // Throws std::runtime_error if the file can't be read or parsed
+    void load(const std::string& path);
+
+    // Cycles of a command decoded as isa_cmd, nullptr for an unknown one,
+    // without stalls
+    uint32_t cycles(const Isa_cmd *isa_cmd) const;
+    bool is_load(const Isa_cmd *isa_cmd) const;
+    uint32_t load_use() const;
+
+private:
+    enum class Cmd_class : uint8_t {
+        alu,
+        load,
+        store,
+        mul,
+        div,
+        atomic,
+        fpu,
+        fdiv,
+        csr,
+        system,
+        branch,
+        jump
+    };
+    static const size_t class_count = (size_t)Cmd_class::jump + 1;
+
+    uint32_t class_cycles_[class_count];
+    uint32_t branch_penalty_;
+    uint32_t load_use_;
+    // Class of every isa_table entry
+    Cmd_class classes_[isa_table_size];
+
+    void parse(const char *data, size_t size);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Loader.h"
+#include <string>
+#include <vector>
+
+// Hex and ASCII dump of data sections, objdump -s style, with OBJECT symbols
+// as labels. Rows hold 16 bytes and start at the section start or at an
+// object, so the layout does not depend on how the dump is split.
+class Data_dump {
+public:
+    static const size_t row_bytes = 16;
+    // Characters of one rendered row, newline included
+    static const size_t row_size = 64;
+
+    Data_dump(Loader& loader);
+
+    // Pieces of the dump rendered independently, in output order
+    size_t chunks_count() const;
+    void render_chunk(size_t chunk, std::string& out) const;
+
+private:
+    struct Chunk {
+        size_t section;
+        // Byte range in the section
+        size_t first;
+        size_t last;
+        // Labels [first_label, last_label) of objects_ go before the rows
+        size_t first_label;
+        size_t last_label;
+    };
+
+    Loader& loader_;
+    std::vector<Data_section> sections_;
+    // OBJECT symbols of data sections by address
+    std::vector<Elf32_Sym> objects_;
+    std::vector<Chunk> chunks_;
+};
+
+// Renders row_size characters of a row of size <= row_bytes bytes at addr,
+// missing bytes are padded with spaces
+void format_data_row(Elf32_Addr addr, const unsigned char *bytes, size_t size, char *out);
@@ -53,4 +53,16 @@ struct Elf32_Sym {
     Elf32_Half    st_shndx;
 };
 
+// Elf file relocation entries without and with addend
+struct Elf32_Rel {
+    Elf32_Addr    r_offset;
+    Elf32_Word    r_info;
+};
+
+struct Elf32_Rela {
+    Elf32_Addr    r_offset;
+    Elf32_Word    r_info;
+    int32_t       r_addend;
+};
+
 #pragma pack(pop)
\ No newline at end of file
@@ -1,42 +1,63 @@
 #pragma once
 
 #include "Elf.h"
+#include "Input_source.h"
+#include "Loader.h"
+#include "Section_table.h"
 #include <string>
 #include <vector>
 
-// Standard way to extract symbol data
-#define ELF32_ST_BIND(info)         ((info) >> 4)
-#define ELF32_ST_TYPE(info)         ((info) & 0xf)
-#define ELF32_ST_VISIBILITY(info)   ((info) & 0x3)
-
-class Elf_parser {
+class Elf_parser : public Loader {
 public:
-    Elf_parser(FILE *elf_file);
-    ~Elf_parser();
+    // source may be a pipe: it is read forward only, without seeking.
+    // .text of a mapped source is used in place, so source must outlive
+    // the parser; anything else is copied out in the constructor.
+    Elf_parser(Input_source& source);
+    // Image starting at base of source, e.g. a member of an archive
+    Elf_parser(Input_source& source, size_t base);
 
-    std::vector<Elf32_Sym> get_symtab();
-    Elf32_Word  get_text_section_idx();
-    std::vector<Elf32_Word> get_text();
-    Elf32_Addr  get_text_start_addr();
+    std::vector<Elf32_Sym> get_symtab() override;
+    Elf32_Word  get_text_section_idx() override;
+    const Elf32_Word* get_text() override;
+    size_t get_text_size() override;
+    Elf32_Addr  get_text_start_addr() override;
 
-    const char* get_symbol_bind(char byte);
-    const char* get_symbol_type(char byte);
-    const char* get_symbol_visibility(char byte);
-    std::string get_symbol_index(Elf32_Half ndx);
-    const char* get_symbol_name(Elf32_Word st_name);
+    const char* get_symbol_name(Elf32_Word st_name) override;
+    // .dynsym symbols, empty for static executables
+    std::vector<Elf32_Sym> get_dynsym() override;
+    const char* get_dynsym_name(Elf32_Word st_name) override;
+    // Allocated, non-executable sections with contents in the file: .bss
+    // and other SHT_NOBITS sections are left out
+    std::vector<Data_section> get_data_sections() override;
+    const unsigned char* get_section(const char *name, size_t& size) override;
+    // .rela.text and .rel.text, symbols of sections by section name
+    std::vector<Relocation> get_text_relocations() override;
+    // ET_REL
+    bool is_relocatable() override;
+    const Section_table& get_section_table() const;
 
 private:
-    FILE *elf_src_;
+    Input_source& source_;
+    size_t base_;
     Elf32_Ehdr elf_header_;
     std::vector<Elf32_Word> text_;
+    const Elf32_Word *text_data_;
+    size_t text_size_;
     std::vector<Elf32_Sym> symtab_;
-    char *symbol_names_;
+    std::string symbol_names_;
+    std::vector<Elf32_Sym> dynsym_;
+    std::string dynsym_names_;
+    Section_table sections_;
+    size_t symtab_section_idx_;
+    size_t dynsym_section_idx_;
     size_t text_section_idx;
     Elf32_Addr text_start_addr;
 
-    void read_text_section(Elf32_Shdr& text_section_hdr);
-    void read_symtable_section(Elf32_Shdr& symtable_section_hdr);
-    void read_strtab_section(Elf32_Shdr& strtab_section_hdr);
+    const unsigned char* read_section(const Elf32_Shdr& section_hdr);
+    void read_text_section(const Elf32_Shdr& text_section_hdr);
+    // First section of type with the string table it links to, nothing if
+    // there is no such section
+    size_t read_symtable_section(Elf32_Word type, std::vector<Elf32_Sym>& symbols, std::string& names);
 
     bool check_magic_bytes();
     bool check_bit_depth();
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Elf.h"
+#include "Input_source.h"
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+// MinHash fingerprints of functions and an on-disk LSH index of them.
+//
+// A function is the set of its 4-command shingles. Commands are normalised
+// first: immediates and addresses are dropped and registers are reduced to
+// zero, ra, sp or any other, so copies placed elsewhere or built with other
+// register allocation still share shingles. Equal signature slots estimate
+// the Jaccard similarity of two sets; signatures are split into bands, and
+// functions sharing a whole band are the candidates of a query.
+namespace function_index {
+
+const size_t signature_size = 64;
+const size_t bands = 16;
+const size_t band_rows = signature_size / bands;
+// Shorter functions, e.g. a bare ret, match each other everywhere
+const size_t min_cmds = 4;
+
+typedef std::array<uint32_t, signature_size> Signature;
+
+// Signature of commands [cmds, cmds + count), false if there are fewer than
+// min_cmds of them
+bool fingerprint(const Elf32_Word *cmds, size_t count, Signature& signature);
+// Share of equal slots of two signatures
+double similarity(const Signature& a, const Signature& b);
+
+}  // namespace function_index
+
+// Functions of any number of objects collected into an index file
+class Function_index_builder {
+public:
+    Function_index_builder();
+
+    void add(const std::string& object, const std::string& function, Elf32_Addr addr, size_t cmds,
+             const function_index::Signature& signature);
+    size_t size() const;
+    // Throws std::runtime_error if the file can't be written
+    void write(const std::string& path) const;
+
+private:
+    struct Record {
+        Elf32_Word object;
+        Elf32_Word function;
+        Elf32_Addr addr;
+        Elf32_Word cmds;
+        function_index::Signature signature;
+    };
+
+    std::vector<Record> records_;
+    std::string names_;
+    // Functions of an object come together, its name is stored once
+    std::string last_object_;
+    Elf32_Word last_object_name_;
+
+    Elf32_Word add_name(const std::string& name);
+};
+
+// Index file, mapped and used in place: a query reads one bucket range per band
+class Function_index {
+public:
+    struct Match {
+        const char *object;
+        const char *function;
+        Elf32_Addr  addr;
+        size_t      cmds;
+        double      similarity;
+    };
+
+    // Throws std::runtime_error if the file can't be read or is not an index
+    Function_index(const std::string& path);
+    ~Function_index();
+
+    size_t size() const;
+    // At most max_matches functions with similarity of at least min_similarity,
+    // most similar first
+    std::vector<Match> query(const function_index::Signature& signature, double min_similarity,
+                             size_t max_matches) const;
+
+private:
+    friend class Function_index_builder;
+    struct Header;
+    struct Bucket;
+    struct Record;
+
+    int file_;
+    std::unique_ptr<Input_source> source_;
+    const Header *header_;
+    const Bucket *buckets_;
+    const Record *records_;
+    const char *names_;
+    size_t names_size_;
+
+    const char* get_name(Elf32_Word offset) const;
+};
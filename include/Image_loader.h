@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Input_source.h"
+#include "Loader.h"
+#include <string>
+#include <vector>
+
+// Flat firmware image without ELF structure: the whole image is code.
+// Symbols come from an optional map file.
+class Image_loader : public Loader {
+public:
+    // Reads "<hex address> [<hex size>] [<type>] <name>" lines, e.g. output of
+    // nm -S. Symbols without size span up to the next symbol or image end.
+    // Type letters t, T, w and W make function symbols, the rest are objects.
+    // Undefined symbols of nm ("U name") are skipped.
+    void load_map(const std::string& path);
+
+    std::vector<Elf32_Sym> get_symtab() override;
+    Elf32_Word get_text_section_idx() override;
+    const Elf32_Word* get_text() override;
+    size_t get_text_size() override;
+    Elf32_Addr get_text_start_addr() override;
+    const char* get_symbol_name(Elf32_Word st_name) override;
+    std::vector<Elf32_Sym> get_dynsym() override;
+    const char* get_dynsym_name(Elf32_Word st_name) override;
+    // The whole image is code, so there are none
+    std::vector<Data_section> get_data_sections() override;
+    const unsigned char* get_section(const char *name, size_t& size) override;
+    std::vector<Relocation> get_text_relocations() override;
+    bool is_relocatable() override;
+
+protected:
+    Image_loader();
+    // Image bytes go to text_, trailing bytes are padded with zeros.
+    // Throws std::runtime_error if start_addr is not word aligned or the
+    // image doesn't fit below 2^32.
+    void set_image(const unsigned char *bytes, size_t size, Elf32_Addr start_addr);
+
+private:
+    std::vector<Elf32_Word> text_;
+    Elf32_Addr text_start_addr_;
+    std::vector<Elf32_Sym> symtab_;
+    std::string symbol_names_;
+};
+
+// Raw binary loaded at base_addr
+class Bin_loader : public Image_loader {
+public:
+    Bin_loader(Input_source& source, Elf32_Addr base_addr);
+};
+
+// Intel HEX image: data, end of file, extended segment and linear address
+// records. Gaps between data records are filled with zeros; a gap of more
+// than 16 MiB is an error, as is a record past the 32-bit address space.
+class Hex_loader : public Image_loader {
+public:
+    Hex_loader(Input_source& source);
+};
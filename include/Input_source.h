@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Bytes of an input file.
+// Regular files are memory mapped. Pipes and other non-seekable inputs are
+// read forward once in large blocks; the bytes read so far are kept, so
+// earlier offsets stay readable without seeking.
+class Input_source {
+public:
+    Input_source(int fd);
+    ~Input_source();
+
+    // Pointer to bytes [offset, offset + size), reads more input if needed.
+    // Throws if the input is shorter. Pointers stay valid until the next read
+    // of bytes which have not arrived yet.
+    const char* read(size_t offset, size_t size);
+    // Pointer to the whole input, reads it to the end if needed
+    const char* read_all(size_t& size);
+    bool is_mapped() const;
+
+private:
+    int fd_;
+    const char *mapped_;
+    size_t mapped_size_;
+    std::vector<char> buffer_;
+    bool eof_;
+
+    void fill(size_t end);
+};
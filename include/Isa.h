@@ -0,0 +1,366 @@
+#pragma once
+
+#include "Elf.h"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+// Instruction set extensions described by isa_table
+enum class Isa_ext : uint8_t {
+    I,
+    M,
+    A,
+    F,
+    D,
+    Zicsr,
+    Zifencei
+};
+
+// One instruction of the ISA.
+// Command cmd is this instruction if (cmd & mask) == match.
+//
+// Operand layout is printed character by character:
+//   d, s, t     integer rd, rs1, rs2
+//   D, S, T, R  float rd, rs1, rs2, rs3
+//   j           I-type immediate, q - S-type immediate
+//   >           shift amount
+//   u           U-type immediate in hex
+//   p           branch target: "0x<addr>, <label>"
+//   a           jal target: "0x<addr> <label>"
+//   E           CSR number or name, Z - 5 bit CSR immediate
+//   P, Q        fence predecessor and successor sets
+//   m           ", <rounding mode>", omitted for the dynamic mode
+// Any other character is printed as is.
+struct Isa_cmd {
+    const char *name;
+    Elf32_Word  mask;
+    Elf32_Word  match;
+    const char *operands;
+    Isa_ext     ext;
+};
+
+// Entries sharing encoding bits must go from the most specific one:
+// the first matching entry wins.
+inline constexpr Isa_cmd isa_table[] = {
+    // RV32I
+    {"lui",       0x0000007f, 0x00000037, "d, u",       Isa_ext::I},
+    {"auipc",     0x0000007f, 0x00000017, "d, u",       Isa_ext::I},
+    {"jal",       0x0000007f, 0x0000006f, "d, a",       Isa_ext::I},
+    {"jalr",      0x0000707f, 0x00000067, "d, j(s)",    Isa_ext::I},
+    {"beq",       0x0000707f, 0x00000063, "s, t, p",    Isa_ext::I},
+    {"bne",       0x0000707f, 0x00001063, "s, t, p",    Isa_ext::I},
+    {"blt",       0x0000707f, 0x00004063, "s, t, p",    Isa_ext::I},
+    {"bge",       0x0000707f, 0x00005063, "s, t, p",    Isa_ext::I},
+    {"bltu",      0x0000707f, 0x00006063, "s, t, p",    Isa_ext::I},
+    {"bgeu",      0x0000707f, 0x00007063, "s, t, p",    Isa_ext::I},
+    {"lb",        0x0000707f, 0x00000003, "d, j(s)",    Isa_ext::I},
+    {"lh",        0x0000707f, 0x00001003, "d, j(s)",    Isa_ext::I},
+    {"lw",        0x0000707f, 0x00002003, "d, j(s)",    Isa_ext::I},
+    {"lbu",       0x0000707f, 0x00004003, "d, j(s)",    Isa_ext::I},
+    {"lhu",       0x0000707f, 0x00005003, "d, j(s)",    Isa_ext::I},
+    {"sb",        0x0000707f, 0x00000023, "t, q(s)",    Isa_ext::I},
+    {"sh",        0x0000707f, 0x00001023, "t, q(s)",    Isa_ext::I},
+    {"sw",        0x0000707f, 0x00002023, "t, q(s)",    Isa_ext::I},
+    {"addi",      0x0000707f, 0x00000013, "d, s, j",    Isa_ext::I},
+    {"slti",      0x0000707f, 0x00002013, "d, s, j",    Isa_ext::I},
+    {"sltiu",     0x0000707f, 0x00003013, "d, s, j",    Isa_ext::I},
+    {"xori",      0x0000707f, 0x00004013, "d, s, j",    Isa_ext::I},
+    {"ori",       0x0000707f, 0x00006013, "d, s, j",    Isa_ext::I},
+    {"andi",      0x0000707f, 0x00007013, "d, s, j",    Isa_ext::I},
+    {"slli",      0xfe00707f, 0x00001013, "d, s, >",    Isa_ext::I},
+    {"srli",      0xfe00707f, 0x00005013, "d, s, >",    Isa_ext::I},
+    {"srai",      0xfe00707f, 0x40005013, "d, s, >",    Isa_ext::I},
+    {"add",       0xfe00707f, 0x00000033, "d, s, t",    Isa_ext::I},
+    {"sub",       0xfe00707f, 0x40000033, "d, s, t",    Isa_ext::I},
+    {"sll",       0xfe00707f, 0x00001033, "d, s, t",    Isa_ext::I},
+    {"slt",       0xfe00707f, 0x00002033, "d, s, t",    Isa_ext::I},
+    {"sltu",      0xfe00707f, 0x00003033, "d, s, t",    Isa_ext::I},
+    {"xor",       0xfe00707f, 0x00004033, "d, s, t",    Isa_ext::I},
+    {"srl",       0xfe00707f, 0x00005033, "d, s, t",    Isa_ext::I},
+    {"sra",       0xfe00707f, 0x40005033, "d, s, t",    Isa_ext::I},
+    {"or",        0xfe00707f, 0x00006033, "d, s, t",    Isa_ext::I},
+    {"and",       0xfe00707f, 0x00007033, "d, s, t",    Isa_ext::I},
+    {"pause",     0xffffffff, 0x0100000f, "",           Isa_ext::I},
+    {"fence.tso", 0xfff0707f, 0x8330000f, "",           Isa_ext::I},
+    {"fence",     0x0000707f, 0x0000000f, "P, Q",       Isa_ext::I},
+    {"ecall",     0xffffffff, 0x00000073, "",           Isa_ext::I},
+    {"ebreak",    0xffffffff, 0x00100073, "",           Isa_ext::I},
+
+    // RV32M
+    {"mul",       0xfe00707f, 0x02000033, "d, s, t",    Isa_ext::M},
+    {"mulh",      0xfe00707f, 0x02001033, "d, s, t",    Isa_ext::M},
+    {"mulhsu",    0xfe00707f, 0x02002033, "d, s, t",    Isa_ext::M},
+    {"mulhu",     0xfe00707f, 0x02003033, "d, s, t",    Isa_ext::M},
+    {"div",       0xfe00707f, 0x02004033, "d, s, t",    Isa_ext::M},
+    {"divu",      0xfe00707f, 0x02005033, "d, s, t",    Isa_ext::M},
+    {"rem",       0xfe00707f, 0x02006033, "d, s, t",    Isa_ext::M},
+    {"remu",      0xfe00707f, 0x02007033, "d, s, t",    Isa_ext::M},
+
+    // RV32A, aq and rl bits are printed as a mnemonic suffix
+    {"lr.w",      0xf9f0707f, 0x1000202f, "d, (s)",     Isa_ext::A},
+    {"sc.w",      0xf800707f, 0x1800202f, "d, t, (s)",  Isa_ext::A},
+    {"amoswap.w", 0xf800707f, 0x0800202f, "d, t, (s)",  Isa_ext::A},
+    {"amoadd.w",  0xf800707f, 0x0000202f, "d, t, (s)",  Isa_ext::A},
+    {"amoxor.w",  0xf800707f, 0x2000202f, "d, t, (s)",  Isa_ext::A},
+    {"amoand.w",  0xf800707f, 0x6000202f, "d, t, (s)",  Isa_ext::A},
+    {"amoor.w",   0xf800707f, 0x4000202f, "d, t, (s)",  Isa_ext::A},
+    {"amomin.w",  0xf800707f, 0x8000202f, "d, t, (s)",  Isa_ext::A},
+    {"amomax.w",  0xf800707f, 0xa000202f, "d, t, (s)",  Isa_ext::A},
+    {"amominu.w", 0xf800707f, 0xc000202f, "d, t, (s)",  Isa_ext::A},
+    {"amomaxu.w", 0xf800707f, 0xe000202f, "d, t, (s)",  Isa_ext::A},
+
+    // RV32F
+    {"flw",       0x0000707f, 0x00002007, "D, j(s)",    Isa_ext::F},
+    {"fsw",       0x0000707f, 0x00002027, "T, q(s)",    Isa_ext::F},
+    {"fmadd.s",   0x0600007f, 0x00000043, "D, S, T, Rm", Isa_ext::F},
+    {"fmsub.s",   0x0600007f, 0x00000047, "D, S, T, Rm", Isa_ext::F},
+    {"fnmsub.s",  0x0600007f, 0x0000004b, "D, S, T, Rm", Isa_ext::F},
+    {"fnmadd.s",  0x0600007f, 0x0000004f, "D, S, T, Rm", Isa_ext::F},
+    {"fadd.s",    0xfe00007f, 0x00000053, "D, S, Tm",   Isa_ext::F},
+    {"fsub.s",    0xfe00007f, 0x08000053, "D, S, Tm",   Isa_ext::F},
+    {"fmul.s",    0xfe00007f, 0x10000053, "D, S, Tm",   Isa_ext::F},
+    {"fdiv.s",    0xfe00007f, 0x18000053, "D, S, Tm",   Isa_ext::F},
+    {"fsqrt.s",   0xfff0007f, 0x58000053, "D, Sm",      Isa_ext::F},
+    {"fsgnj.s",   0xfe00707f, 0x20000053, "D, S, T",    Isa_ext::F},
+    {"fsgnjn.s",  0xfe00707f, 0x20001053, "D, S, T",    Isa_ext::F},
+    {"fsgnjx.s",  0xfe00707f, 0x20002053, "D, S, T",    Isa_ext::F},
+    {"fmin.s",    0xfe00707f, 0x28000053, "D, S, T",    Isa_ext::F},
+    {"fmax.s",    0xfe00707f, 0x28001053, "D, S, T",    Isa_ext::F},
+    {"fcvt.w.s",  0xfff0007f, 0xc0000053, "d, Sm",      Isa_ext::F},
+    {"fcvt.wu.s", 0xfff0007f, 0xc0100053, "d, Sm",      Isa_ext::F},
+    {"fmv.x.w",   0xfff0707f, 0xe0000053, "d, S",       Isa_ext::F},
+    {"feq.s",     0xfe00707f, 0xa0002053, "d, S, T",    Isa_ext::F},
+    {"flt.s",     0xfe00707f, 0xa0001053, "d, S, T",    Isa_ext::F},
+    {"fle.s",     0xfe00707f, 0xa0000053, "d, S, T",    Isa_ext::F},
+    {"fclass.s",  0xfff0707f, 0xe0001053, "d, S",       Isa_ext::F},
+    {"fcvt.s.w",  0xfff0007f, 0xd0000053, "D, sm",      Isa_ext::F},
+    {"fcvt.s.wu", 0xfff0007f, 0xd0100053, "D, sm",      Isa_ext::F},
+    {"fmv.w.x",   0xfff0707f, 0xf0000053, "D, s",       Isa_ext::F},
+
+    // RV32D
+    {"fld",       0x0000707f, 0x00003007, "D, j(s)",    Isa_ext::D},
+    {"fsd",       0x0000707f, 0x00003027, "T, q(s)",    Isa_ext::D},
+    {"fmadd.d",   0x0600007f, 0x02000043, "D, S, T, Rm", Isa_ext::D},
+    {"fmsub.d",   0x0600007f, 0x02000047, "D, S, T, Rm", Isa_ext::D},
+    {"fnmsub.d",  0x0600007f, 0x0200004b, "D, S, T, Rm", Isa_ext::D},
+    {"fnmadd.d",  0x0600007f, 0x0200004f, "D, S, T, Rm", Isa_ext::D},
+    {"fadd.d",    0xfe00007f, 0x02000053, "D, S, Tm",   Isa_ext::D},
+    {"fsub.d",    0xfe00007f, 0x0a000053, "D, S, Tm",   Isa_ext::D},
+    {"fmul.d",    0xfe00007f, 0x12000053, "D, S, Tm",   Isa_ext::D},
+    {"fdiv.d",    0xfe00007f, 0x1a000053, "D, S, Tm",   Isa_ext::D},
+    {"fsqrt.d",   0xfff0007f, 0x5a000053, "D, Sm",      Isa_ext::D},
+    {"fsgnj.d",   0xfe00707f, 0x22000053, "D, S, T",    Isa_ext::D},
+    {"fsgnjn.d",  0xfe00707f, 0x22001053, "D, S, T",    Isa_ext::D},
+    {"fsgnjx.d",  0xfe00707f, 0x22002053, "D, S, T",    Isa_ext::D},
+    {"fmin.d",    0xfe00707f, 0x2a000053, "D, S, T",    Isa_ext::D},
+    {"fmax.d",    0xfe00707f, 0x2a001053, "D, S, T",    Isa_ext::D},
+    {"fcvt.s.d",  0xfff0007f, 0x40100053, "D, Sm",      Isa_ext::D},
+    {"fcvt.d.s",  0xfff0007f, 0x42000053, "D, S",       Isa_ext::D},
+    {"feq.d",     0xfe00707f, 0xa2002053, "d, S, T",    Isa_ext::D},
+    {"flt.d",     0xfe00707f, 0xa2001053, "d, S, T",    Isa_ext::D},
+    {"fle.d",     0xfe00707f, 0xa2000053, "d, S, T",    Isa_ext::D},
+    {"fclass.d",  0xfff0707f, 0xe2001053, "d, S",       Isa_ext::D},
+    {"fcvt.w.d",  0xfff0007f, 0xc2000053, "d, Sm",      Isa_ext::D},
+    {"fcvt.wu.d", 0xfff0007f, 0xc2100053, "d, Sm",      Isa_ext::D},
+    {"fcvt.d.w",  0xfff0007f, 0xd2000053, "D, s",       Isa_ext::D},
+    {"fcvt.d.wu", 0xfff0007f, 0xd2100053, "D, s",       Isa_ext::D},
+
+    // Zicsr
+    {"csrrw",     0x0000707f, 0x00001073, "d, E, s",    Isa_ext::Zicsr},
+    {"csrrs",     0x0000707f, 0x00002073, "d, E, s",    Isa_ext::Zicsr},
+    {"csrrc",     0x0000707f, 0x00003073, "d, E, s",    Isa_ext::Zicsr},
+    {"csrrwi",    0x0000707f, 0x00005073, "d, E, Z",    Isa_ext::Zicsr},
+    {"csrrsi",    0x0000707f, 0x00006073, "d, E, Z",    Isa_ext::Zicsr},
+    {"csrrci",    0x0000707f, 0x00007073, "d, E, Z",    Isa_ext::Zicsr},
+
+    // Zifencei
+    {"fence.i",   0x0000707f, 0x0000100f, "",           Isa_ext::Zifencei},
+};
+
+inline constexpr size_t isa_table_size = sizeof(isa_table) / sizeof(isa_table[0]);
+
+constexpr bool isa_same_name(const char *a, const char *b) {
+    while (*a != '\0' && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+// Entry of isa_table by name, usable in constant expressions.
+// In a constant expression a name missing from the table fails compilation.
+constexpr const Isa_cmd* isa_find(const char *name) {
+    for (size_t i = 0; i < isa_table_size; i++) {
+        if (isa_same_name(isa_table[i].name, name)) {
+            return &isa_table[i];
+        }
+    }
+    throw std::invalid_argument("Unknown instruction name.");
+}
+
+// Rounding modes of the F and D extensions, 7 is the dynamic one
+inline constexpr const char *isa_rounding_modes[8] = {
+    "rne", "rtz", "rdn", "rup", "rmm", "rm5", "rm6", "dyn"
+};
+inline constexpr Elf32_Word isa_rm_dynamic = 7;
+
+struct Isa_csr {
+    Elf32_Word  number;
+    const char *name;
+};
+
+// CSRs printed by name, any other one is printed as a number
+inline constexpr Isa_csr isa_csr_names[] = {
+    {0x001, "fflags"},   {0x002, "frm"},      {0x003, "fcsr"},
+    {0x300, "mstatus"},  {0x301, "misa"},     {0x304, "mie"},
+    {0x305, "mtvec"},    {0x340, "mscratch"}, {0x341, "mepc"},
+    {0x342, "mcause"},   {0x343, "mtval"},    {0x344, "mip"},
+    {0xb00, "mcycle"},   {0xb02, "minstret"}, {0xb80, "mcycleh"},
+    {0xb82, "minstreth"},{0xc00, "cycle"},    {0xc01, "time"},
+    {0xc02, "instret"},  {0xc80, "cycleh"},   {0xc81, "timeh"},
+    {0xc82, "instreth"}, {0xf11, "mvendorid"},{0xf12, "marchid"},
+    {0xf13, "mimpid"},   {0xf14, "mhartid"},
+};
+
+// Immediates of the base instruction formats, sign extended
+constexpr int32_t isa_imm_i(Elf32_Word cmd) {
+    return (int32_t)cmd >> 20;
+}
+
+constexpr int32_t isa_imm_s(Elf32_Word cmd) {
+    return (int32_t)(cmd & 0xfe000000) >> 20 | (int32_t)((cmd >> 7) & 0x1f);
+}
+
+constexpr int32_t isa_imm_b(Elf32_Word cmd) {
+    return (int32_t)(cmd & 0x80000000) >> 19 | (int32_t)((cmd & 0x80) << 4) |
+           (int32_t)((cmd >> 20) & 0x7e0) | (int32_t)((cmd >> 7) & 0x1e);
+}
+
+constexpr Elf32_Word isa_imm_u(Elf32_Word cmd) {
+    return cmd >> 12;
+}
+
+constexpr int32_t isa_imm_j(Elf32_Word cmd) {
+    return (int32_t)(cmd & 0x80000000) >> 11 | (int32_t)(cmd & 0xff000) |
+           (int32_t)((cmd >> 9) & 0x800) | (int32_t)((cmd >> 20) & 0x7fe);
+}
+
+// Decode tables are generated from isa_table at compile time.
+//
+// The first level is indexed with opcode[6..2] and funct3. A bucket whose
+// instructions differ in funct7 is widened to 128 slots indexed with it.
+// Every slot keeps the few isa_table entries that may match there, so
+// decoding costs one table walk and at most isa_slot_capacity compares
+// however large the table is.
+namespace isa_detail {
+
+inline constexpr size_t bucket_count = 256;
+inline constexpr Elf32_Word bucket_bits = 0x0000707c;
+inline constexpr Elf32_Word funct7_bits = 0xfe000000;
+inline constexpr size_t slot_capacity = 4;
+
+static_assert(isa_table_size < 255, "isa_table entries are indexed with uint8_t");
+
+constexpr size_t bucket_of(Elf32_Word cmd) {
+    return ((cmd >> 2) & 0x1f) << 3 | ((cmd >> 12) & 0x7);
+}
+
+constexpr Elf32_Word bucket_cmd(size_t bucket) {
+    return (Elf32_Word)((bucket >> 3) << 2 | (bucket & 0x7) << 12);
+}
+
+constexpr bool in_bucket(const Isa_cmd& cmd, size_t bucket) {
+    return ((bucket_cmd(bucket) ^ cmd.match) & cmd.mask & bucket_bits) == 0;
+}
+
+constexpr bool is_wide(size_t bucket) {
+    for (size_t i = 0; i < isa_table_size; i++) {
+        if (in_bucket(isa_table[i], bucket) && (isa_table[i].mask & funct7_bits) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr size_t count_slots() {
+    size_t slots = 0;
+    for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+        slots += is_wide(bucket) ? 128 : 1;
+    }
+    return slots;
+}
+
+inline constexpr size_t slot_count = count_slots();
+
+struct Bucket {
+    uint16_t base;
+    bool wide;
+};
+
+struct Slot {
+    uint8_t count;
+    uint8_t cmds[slot_capacity];
+};
+
+struct Tables {
+    std::array<Bucket, bucket_count> buckets;
+    std::array<Slot, slot_count> slots;
+    bool overflow;
+};
+
+constexpr Tables build_tables() {
+    Tables tables{};
+    size_t base = 0;
+
+    for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+        // Entries which may be found in this bucket, in table order
+        uint8_t candidates[isa_table_size] = {};
+        size_t candidate_count = 0;
+        for (size_t i = 0; i < isa_table_size; i++) {
+            if (in_bucket(isa_table[i], bucket)) {
+                candidates[candidate_count++] = (uint8_t)i;
+            }
+        }
+
+        bool wide = is_wide(bucket);
+        tables.buckets[bucket] = {(uint16_t)base, wide};
+        size_t width = wide ? 128 : 1;
+
+        for (size_t funct7 = 0; funct7 < width; funct7++) {
+            Slot& slot = tables.slots[base + funct7];
+            for (size_t k = 0; k < candidate_count; k++) {
+                const Isa_cmd& cmd = isa_table[candidates[k]];
+                if (wide && (((Elf32_Word)funct7 << 25 ^ cmd.match) & cmd.mask & funct7_bits) != 0) {
+                    continue;
+                }
+                if (slot.count == slot_capacity) {
+                    tables.overflow = true;
+                    break;
+                }
+                slot.cmds[slot.count++] = candidates[k];
+            }
+        }
+        base += width;
+    }
+    return tables;
+}
+
+inline constexpr Tables tables = build_tables();
+
+static_assert(!tables.overflow, "Too many isa_table entries share one decode slot");
+static_assert(slot_count <= 0xffff, "Decode slots are indexed with uint16_t");
+
+}  // namespace isa_detail
+
+// Finds the isa_table entry of cmd, nullptr for an unknown command
+inline const Isa_cmd* isa_decode(Elf32_Word cmd) {
+    const isa_detail::Bucket& bucket = isa_detail::tables.buckets[isa_detail::bucket_of(cmd)];
+    const isa_detail::Slot& slot = isa_detail::tables.slots[bucket.base + (bucket.wide ? cmd >> 25 : 0)];
+    for (size_t i = 0; i < slot.count; i++) {
+        const Isa_cmd& candidate = isa_table[slot.cmds[i]];
+        if ((cmd & candidate.mask) == candidate.match) {
+            return &candidate;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Loader.h"
+#include <string>
+#include <vector>
+
+// Address to source line table of DWARF .debug_line, versions 2 to 5.
+// Line programs of all units are run once; rows are sorted by address.
+class Line_table {
+public:
+    struct Row {
+        Elf32_Addr addr;
+        // Index into files()
+        uint32_t   file;
+        // 0 for code without a source line
+        uint32_t   line;
+    };
+
+    // Empty table if the loader has no .debug_line.
+    // Throws std::runtime_error on a malformed line program and for a
+    // relocatable object: its .debug_line relocations are not applied, so
+    // file names and addresses of the program would be wrong.
+    Line_table(Loader& loader);
+
+    // A row per address where the source line changes
+    const std::vector<Row>& rows() const;
+    // Index of the first row at or after addr
+    size_t lower_bound(Elf32_Addr addr) const;
+    // Paths of all units, each path once
+    const std::vector<std::string>& files() const;
+
+private:
+    std::vector<Row> rows_;
+    std::vector<std::string> files_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Elf.h"
+#include <string>
+#include <vector>
+
+// Standard way to extract symbol data
+#define ELF32_ST_BIND(info)         ((info) >> 4)
+#define ELF32_ST_TYPE(info)         ((info) & 0xf)
+#define ELF32_ST_VISIBILITY(info)   ((info) & 0x3)
+#define ELF32_ST_INFO(bind, type)   (((bind) << 4) + ((type) & 0xf))
+
+// Symbol bindings and types
+#define STB_GLOBAL  1
+#define STT_NOTYPE  0
+#define STT_OBJECT  1
+#define STT_FUNC    2
+#define STT_SECTION 3
+
+// Allocated section holding data rather than code, e.g. .rodata or .data
+struct Data_section {
+    std::string name;
+    // st_shndx of its symbols
+    Elf32_Half  index;
+    Elf32_Addr  addr;
+    const unsigned char *data;
+    size_t      size;
+};
+
+// Relocation of a command in the code section
+struct Relocation {
+    // Offset of the command from the start of the section
+    Elf32_Word  offset;
+    Elf32_Word  type;
+    // Symbol or section name, "" if none
+    const char *symbol;
+    int32_t     addend;
+};
+
+// Program image to disassemble: commands of one code section and symbols
+// in ELF form. Elf_parser is one implementation, flat images are others.
+class Loader {
+public:
+    virtual ~Loader() {}
+
+    virtual std::vector<Elf32_Sym> get_symtab() = 0;
+    // Symbols with this st_shndx are in the code section
+    virtual Elf32_Word get_text_section_idx() = 0;
+    // Commands of the code section, valid while the loader and its input live
+    virtual const Elf32_Word* get_text() = 0;
+    virtual size_t get_text_size() = 0;
+    virtual Elf32_Addr get_text_start_addr() = 0;
+    virtual const char* get_symbol_name(Elf32_Word st_name) = 0;
+    // .dynsym symbols, empty if the image has none
+    virtual std::vector<Elf32_Sym> get_dynsym() = 0;
+    virtual const char* get_dynsym_name(Elf32_Word st_name) = 0;
+    // Data sections in address order, their bytes are valid while the loader
+    // and its input live
+    virtual std::vector<Data_section> get_data_sections() = 0;
+    // Contents of the named section, e.g. .debug_line, nullptr if there is
+    // none. Valid while the loader and its input live.
+    virtual const unsigned char* get_section(const char *name, size_t& size) = 0;
+    // Relocations of the code section sorted by offset, one per command
+    virtual std::vector<Relocation> get_text_relocations() = 0;
+    // Object whose sections are not relocated yet, e.g. a .o of an archive
+    virtual bool is_relocatable() = 0;
+
+    const char* get_symbol_bind(char byte);
+    const char* get_symbol_type(char byte);
+    const char* get_symbol_visibility(char byte);
+    std::string get_symbol_index(Elf32_Half ndx);
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Command line of risc_disasm
+struct Options {
+    // Several inputs, or an archive, are listed object by object
+    std::vector<std::string> inputs;
+    // "elf", "bin" or "hex", empty to tell ELF and HEX by content
+    std::string format;
+    // Load address of a raw binary
+    uint32_t base_addr = 0;
+    bool has_base_addr = false;
+    // Symbols of a raw binary or HEX image, empty if none
+    std::string map;
+    std::string output;
+    bool annotate_lines = false;
+    bool pseudo_instructions = false;
+    // Sample file, empty if none
+    std::string profile;
+    // Print only this many functions with the most samples, 0 prints all
+    size_t top_functions = 0;
+    // Interleave source lines of .debug_line with the listing
+    bool source_lines = false;
+    // Cycle model config, non-empty to annotate blocks with cycle estimates
+    std::string cycles;
+    // Dump data sections after the listing
+    bool dump_data = false;
+    // Print registers used by every function instead of the listing
+    bool register_usage = false;
+    // Render only these functions and only commands in [start_address, stop_address)
+    std::vector<std::string> functions;
+    uint32_t start_address = 0;
+    uint32_t stop_address = UINT32_MAX;
+    // Print render cache statistics to stderr
+    bool stats = false;
+    // Write a similarity index of functions of the inputs to this file
+    std::string build_index;
+    // Print functions of this index similar to functions of the inputs
+    std::string query_index;
+    double min_similarity = 0.5;
+    // Trace of raw PCs to render instead of the listing, empty if none
+    std::string trace;
+};
+
+// Throws std::runtime_error on an unknown option or wrong number of file names
+Options parse_options(int argc, char **argv);
+// Throws std::runtime_error if options need a single image, e.g. --trace,
+// while several objects are listed
+void check_several_objects(const Options& options);
+// Throws std::runtime_error if options do not go with --build-index or
+// --query-index
+void check_function_index(const Options& options);
+const char* usage();
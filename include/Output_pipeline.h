@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Ordered output stage. Render threads fill buffers and submit them with
+// sequence numbers; a dedicated writer thread drains them to fd in order
+// with large writes (io_uring when the kernel provides it, writev otherwise).
+//
+// Buffers come from a fixed pool, so rendering blocks instead of growing
+// memory when the output is slower than the renderers. To never deadlock,
+// a producer takes a buffer first and only then picks the next sequence number.
+class Output_pipeline {
+public:
+    Output_pipeline(int fd, size_t buffer_count, size_t buffer_size);
+    ~Output_pipeline();
+
+    // Takes an empty buffer, blocks while all buffers are in use
+    std::string* acquire();
+    // Returns an unused buffer to the pool
+    void release(std::string* buffer);
+    // Queues buffer holding the seq-th piece of output, seq starts with 0
+    void submit(size_t seq, std::string* buffer);
+    // Waits until every submitted piece is written, throws on write error
+    void finish();
+
+private:
+    struct Uring;
+
+    int fd_;
+    long long offset_;    // write position of a seekable fd, -1 for pipes
+    std::vector<std::string> buffers_;
+    std::vector<std::string*> free_;
+    std::map<size_t, std::string*> ready_;
+    size_t next_seq_;
+    bool finishing_;
+    int error_;
+    std::mutex mutex_;
+    std::condition_variable buffer_freed_;
+    std::condition_variable buffer_ready_;
+    std::unique_ptr<Uring> uring_;
+    std::thread writer_;
+
+    void write_loop();
+    int write_buffers(const std::vector<std::string*>& batch);
+    int write_all(const std::vector<std::string*>& batch);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Elf.h"
+#include "Isa.h"
+
+// Pseudo-instruction printed instead of a command
+enum class Pseudo_kind : uint8_t {
+    none,       // command is printed as is
+    nop,
+    mv,         // mv rd, rs
+    li,         // li rd, value
+    ret,
+    j,          // j value
+    call,       // call value, from auipc + jalr ra
+    tail,       // tail value, from auipc + jalr zero
+    la,         // la rd, value, from auipc + addi
+    fused       // second command of the previous pair, printed without text
+};
+
+struct Pseudo {
+    Pseudo_kind kind;
+    Elf32_Word  rd;
+    Elf32_Word  rs;
+    Elf32_Word  value;
+    // Command uses an address built by an earlier lui/auipc
+    bool        resolved;
+    Elf32_Addr  address;
+};
+
+// Streaming peephole stage over already decoded commands.
+// Commands go in address order. Pairs are matched with the next command only,
+// lui/auipc values are remembered for a short window of following commands
+// to resolve addresses of addi, jalr, loads and stores based on them.
+class Peephole {
+public:
+    // Number of commands a lui/auipc value is remembered for
+    static const size_t window = 8;
+
+    Peephole();
+    // Forgets remembered values, e.g. at a branch target
+    void reset();
+    // cmd at addr decoded as isa_cmd, nullptr if invalid. next_isa_cmd is the
+    // decoded next command or nullptr if a pair must not be matched with it.
+    Pseudo step(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr,
+                Elf32_Word next, const Isa_cmd *next_isa_cmd);
+
+private:
+    struct Hi_value {
+        Elf32_Word value;
+        size_t     until;
+    };
+
+    Hi_value regs_[32];
+    size_t   count_;
+    bool     fused_;
+
+    bool match_pair(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr,
+                    Elf32_Word next, const Isa_cmd *next_isa_cmd, Pseudo& pseudo) const;
+    void match_single(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr, Pseudo& pseudo) const;
+    void resolve(Elf32_Word cmd, const Isa_cmd *isa_cmd, Pseudo& pseudo) const;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Elf.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// PC samples joined with .text commands.
+// Sample file has one "<hex address> [count]" per line, count is 1 if
+// omitted; empty lines and lines starting with '#' are skipped.
+class Profile {
+public:
+    Profile();
+    // Throws std::runtime_error if the file can't be read or parsed
+    void load(const std::string& path);
+    // Sums samples per command of .text with cmds_count commands from text_start
+    void join(Elf32_Addr text_start, size_t cmds_count);
+
+    // All loaded samples, including ones outside .text
+    uint64_t total() const;
+    // Samples of commands [first, last), valid after join()
+    uint64_t count(size_t first, size_t last) const;
+
+private:
+    struct Sample {
+        Elf32_Addr addr;
+        uint64_t   count;
+    };
+
+    std::vector<Sample> samples_;
+    // cumulative_[i] is the number of samples of commands before i
+    std::vector<uint64_t> cumulative_;
+    uint64_t total_;
+
+    void parse(const char *data, size_t size);
+    void sort_samples();
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// Integer registers used by a function or a basic block as 32-bit sets,
+// bit i stands for register xi
+struct Register_usage {
+    // Read before written in the same basic block
+    uint32_t read = 0;
+    uint32_t written = 0;
+    // Stored with sw to or loaded with lw from a sp-relative slot
+    uint32_t saved = 0;
+    uint32_t restored = 0;
+
+    void add_block(const Register_usage& block) {
+        read |= block.read;
+        written |= block.written;
+        saved |= block.saved;
+        restored |= block.restored;
+    }
+
+    uint32_t preserved() const {
+        return saved & restored;
+    }
+
+    // Written and not preserved; sp is assumed to be balanced on return
+    uint32_t clobbered() const {
+        const uint32_t sp = 1u << 2;
+        return written & ~preserved() & ~sp;
+    }
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Elf.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Direct-mapped hash cache from a command word to its rendered text.
+// Only for commands whose text does not depend on their address, i.e.
+// everything but branches and jal. Not thread-safe: one cache per thread.
+class Render_cache {
+public:
+    static const size_t slots = 4096;
+    // Longer texts are not cached
+    static const size_t max_text_size = 59;
+
+    Render_cache();
+    // Appends cached text of word, returns false on a miss
+    bool append(Elf32_Word word, std::string& out);
+    void insert(Elf32_Word word, const char *text, size_t size);
+
+    uint64_t lookups() const;
+    uint64_t hits() const;
+
+private:
+    // One cache line per entry, size 0 marks an empty entry
+    struct alignas(64) Entry {
+        Elf32_Word word;
+        uint8_t    size;
+        char       text[max_text_size];
+    };
+
+    Entry entries_[slots];
+    uint64_t lookups_;
+    uint64_t hits_;
+
+    size_t slot(Elf32_Word word) const;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Elf.h"
+#include "Input_source.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Section types and flags
+#define SHT_NULL       0
+#define SHT_SYMTAB     2    // Symbol table
+#define SHT_STRTAB     3    // String table
+#define SHT_RELA       4    // Relocations with addends
+#define SHT_NOBITS     8    // Section occupies no file space
+#define SHT_REL        9    // Relocations without addends
+#define SHT_DYNSYM     11   // Dynamic symbol table
+#define SHF_ALLOC      0x2  // Section is loaded into memory
+#define SHF_EXECINSTR  0x4  // Section holds commands
+
+// Section header table of an ELF image, read in one block and validated:
+// contents of every section lie inside the input and every name inside the
+// section names. Sections are found by name and by type through hash indexes.
+class Section_table {
+public:
+    Section_table();
+    // Reads the table of the image at base of source described by header.
+    // Throws std::runtime_error on an invalid table.
+    void load(Input_source& source, size_t base, const Elf32_Ehdr& header);
+
+    size_t size() const;
+    const Elf32_Shdr& get(size_t idx) const;
+    const char* get_name(size_t idx) const;
+    // Index of the first section called name, 0 (the null section) if none
+    size_t find(const char *name) const;
+    // Indexes of all sections of type in table order
+    const std::vector<size_t>& find_type(Elf32_Word type) const;
+    // End of the furthest section contents, relative to the image start
+    size_t contents_end() const;
+
+private:
+    std::vector<Elf32_Shdr> headers_;
+    std::string names_;
+    std::unordered_map<std::string, size_t> by_name_;
+    std::unordered_map<Elf32_Word, std::vector<size_t>> by_type_;
+    size_t contents_end_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Input_source.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Source files by index, each opened and mapped once, on first use, together
+// with an index of its line starts. Safe to use from any number of threads.
+class Source_pool {
+public:
+    Source_pool(const std::vector<std::string>& paths);
+
+    // Text of line (counted from 1) of file without the line break, false if
+    // the file cannot be read or has fewer lines
+    bool get_line(uint32_t file, uint32_t line, const char*& text, size_t& size);
+
+private:
+    struct File {
+        std::once_flag opened;
+        std::unique_ptr<Input_source> source;
+        const char *data = nullptr;
+        size_t size = 0;
+        std::vector<size_t> line_starts;
+    };
+
+    std::vector<std::string> paths_;
+    std::vector<File> files_;
+
+    void open_file(uint32_t file);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Elf.h"
+#include <string>
+#include <vector>
+
+// Address to containing symbol index over sized symbols.
+// Symbols are kept sorted by start address, so a lookup is a binary search.
+class Symbol_index {
+public:
+    struct Symbol {
+        Elf32_Addr  start;
+        Elf32_Word  size;
+        std::string name;
+        // STT_FUNC, STT_OBJECT or STT_NOTYPE
+        unsigned char type;
+    };
+
+    void add(Elf32_Addr start, Elf32_Word size, const char *name, unsigned char type);
+    // Sorts symbols; must be called after the last add() and before lookups.
+    // Of aliases sharing a start address a function is kept, otherwise the
+    // first added one.
+    void build();
+    bool empty() const;
+
+    // Symbol whose [start, start + size) contains addr, nullptr if none
+    const Symbol* find(Elf32_Addr addr) const;
+    // Appends "name" or "name+0x<offset>" of the symbol containing addr.
+    // Returns false and appends nothing if there is no such symbol.
+    bool append_location(Elf32_Addr addr, std::string& out) const;
+    // All symbols sorted by start address
+    const std::vector<Symbol>& symbols() const;
+
+private:
+    std::vector<Symbol> symbols_;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Cmd_parser.h"
+#include <string>
+#include <vector>
+
+// Direct-mapped cache of rendered lines by PC.
+// A miss renders the line from .text of the parser, a hit is a copy of the
+// cached line. Not thread-safe: each thread needs its own cache.
+class Trace_cache {
+public:
+    // slots must be a power of two
+    Trace_cache(const Cmd_parser& parser, size_t slots);
+    // Appends the line of the command at pc
+    void append_line(Elf32_Addr pc, std::string& out);
+
+private:
+    struct Slot {
+        Elf32_Addr  pc;
+        bool        valid;
+        std::string line;
+    };
+
+    const Cmd_parser& parser_;
+    std::vector<Slot> slots_;
+    size_t mask_;
+};
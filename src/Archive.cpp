@@ -0,0 +1,96 @@
+#include "Archive.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+static const char archive_magic[] = "!<arch>\n";
+const size_t archive_magic_size = 8;
+
+// Member header, all fields are space-padded text
+struct Ar_header {
+    char name[16];
+    char date[12];
+    char uid[6];
+    char gid[6];
+    char mode[8];
+    char size[10];
+    char end[2];
+};
+static_assert(sizeof(Ar_header) == 60, "ar header is 60 bytes");
+
+bool Archive::is_archive(Input_source& source) {
+    try {
+        return memcmp(source.read(0, archive_magic_size), archive_magic, archive_magic_size) == 0;
+    } catch (std::runtime_error&) {
+        // Input shorter than the magic
+        return false;
+    }
+}
+
+Archive::Archive(Input_source& source) {
+    size_t size;
+    const char *data = source.read_all(size);
+    if (size < archive_magic_size || memcmp(data, archive_magic, archive_magic_size) != 0) {
+        throw std::runtime_error("Not an archive.");
+    }
+
+    std::string long_names;
+    size_t pos = archive_magic_size;
+    while (pos + sizeof(Ar_header) <= size) {
+        Ar_header header;
+        memcpy(&header, data + pos, sizeof(Ar_header));
+        std::string field_size(header.size, sizeof(header.size));
+        char *end;
+        size_t member_size = strtoul(field_size.c_str(), &end, 10);
+        if (memcmp(header.end, "`\n", 2) != 0 || end == field_size.c_str() ||
+            member_size > size - pos - sizeof(Ar_header)) {
+            throw std::runtime_error("Invalid archive member header.");
+        }
+
+        Member member = {std::string(header.name, sizeof(header.name)), pos + sizeof(Ar_header), member_size};
+        member.name.erase(member.name.find_last_not_of(' ') + 1);
+        // Members start at even offsets
+        pos = member.offset + member_size + member_size % 2;
+
+        if (member.name == "/" || member.name == "/SYM64/") {
+            continue;
+        }
+        if (member.name == "//") {
+            long_names.assign(data + member.offset, member.size);
+            continue;
+        }
+        if (member.name.size() > 1 && member.name[0] == '/') {
+            // GNU long name: offset into the name table, name ends with "/\n"
+            size_t name_offset = strtoul(member.name.c_str() + 1, nullptr, 10);
+            if (name_offset >= long_names.size()) {
+                throw std::runtime_error("Invalid archive member name.");
+            }
+            size_t name_end = long_names.find('\n', name_offset);
+            member.name = long_names.substr(name_offset, name_end == std::string::npos ? std::string::npos : name_end - name_offset);
+        }
+        else if (member.name.compare(0, 3, "#1/") == 0) {
+            // BSD long name: it goes first in the member data
+            size_t name_size = strtoul(member.name.c_str() + 3, nullptr, 10);
+            if (name_size > member.size) {
+                throw std::runtime_error("Invalid archive member name.");
+            }
+            member.name.assign(data + member.offset, name_size);
+            member.name.erase(member.name.find('\0') == std::string::npos ? member.name.size() : member.name.find('\0'));
+            member.offset += name_size;
+            member.size -= name_size;
+        }
+        // GNU names end with '/'
+        if (!member.name.empty() && member.name.back() == '/') {
+            member.name.pop_back();
+        }
+        // BSD symbol index, its name may be a long one
+        if (member.name.compare(0, 9, "__.SYMDEF") == 0) {
+            continue;
+        }
+        members_.push_back(member);
+    }
+}
+
+const std::vector<Archive::Member>& Archive::members() const {
+    return members_;
+}
@@ -1,41 +1,98 @@
 #include "Cmd_parser.h"
+#include <algorithm>
+#include <cstring>
 
-Cmd_parser::Cmd_parser(Elf_parser &elf_file) : elf_file_(elf_file), cur_addr_ptr_(0), L_label_counter_(0) {
-    std::vector<Elf32_Sym> sym = elf_file_.get_symtab();
+// Each rendering thread has its own cache, shared by all parsers
+static Render_cache& thread_render_cache() {
+    thread_local Render_cache cache;
+    return cache;
+}
+
+Cmd_parser::Cmd_parser(Loader &loader) : loader_(&loader), L_label_counter_(0), annotate_lines_(false), pseudo_instructions_(false), profile_(nullptr),
+                                           lines_(nullptr), sources_(nullptr), cycle_model_(nullptr), cache_lookups_(0), cache_hits_(0) {
+    std::vector<Elf32_Sym> sym = loader_->get_symtab();
 
     for (size_t i = 0; i < sym.size(); i++) {
-        const char *label = elf_file_.get_symbol_name(sym[i].st_name);
+        const char *label = loader_->get_symbol_name(sym[i].st_name);
         // Save symbols from .text section
-        if (sym[i].st_shndx == elf_file_.get_text_section_idx()) {
+        if (sym[i].st_shndx == loader_->get_text_section_idx()) {
             symtab_[sym[i].st_value] = std::string(label);
         }
+        add_to_index(sym[i], label);
+    }
+
+    std::vector<Elf32_Sym> dynsym = loader_->get_dynsym();
+    for (size_t i = 0; i < dynsym.size(); i++) {
+        add_to_index(dynsym[i], loader_->get_dynsym_name(dynsym[i].st_name));
+    }
+    symbols_.build();
+    for (auto& section : data_symbols_) {
+        section.second.build();
     }
-}
 
-bool Cmd_parser::get_bit(Elf32_Word value, size_t pos) {
-    return value & (1 << pos);
+    text_ = loader_->get_text();
+    text_size_ = loader_->get_text_size();
+    text_start_addr_ = loader_->get_text_start_addr();
+    relocations_ = loader_->get_text_relocations();
 }
 
-void Cmd_parser::set_bit(Elf32_Word& dst, size_t pos, bool bit) {
-    if (get_bit(dst, pos) != bit) {
-        dst ^= (1 << pos);
+// Decoder without ELF context: every branch target gets a generated label
+Cmd_parser::Cmd_parser() : loader_(nullptr), text_(nullptr), text_size_(0), text_start_addr_(0), L_label_counter_(0), annotate_lines_(false), pseudo_instructions_(false), profile_(nullptr),
+                           lines_(nullptr), sources_(nullptr), cycle_model_(nullptr), cache_lookups_(0), cache_hits_(0) {}
+
+// Defined code and data symbols with a size go to the address index of
+// their section
+void Cmd_parser::add_to_index(const Elf32_Sym& symbol, const char *name) {
+    unsigned char type = ELF32_ST_TYPE(symbol.st_info);
+    if (symbol.st_shndx == 0 || (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE)) {
+        return;
+    }
+    if (symbol.st_shndx == loader_->get_text_section_idx()) {
+        symbols_.add(symbol.st_value, symbol.st_size, name, type);
+    }
+    else {
+        data_symbols_[symbol.st_shndx].add(symbol.st_value, symbol.st_size, name, type);
     }
 }
 
-void Cmd_parser::write_bits(Elf32_Word src, size_t start, size_t end, Elf32_Word& dst, size_t pos) {
-    for (size_t i = 0; i <= end - start; i++) {
-        set_bit(dst, pos + i, get_bit(src, start + i));
+// Appends "name" or "name+0x<offset>" of a data symbol containing addr, the
+// first section with one wins
+bool Cmd_parser::append_data_location(Elf32_Addr addr, std::string& out) const {
+    for (const auto& section : data_symbols_) {
+        if (section.second.append_location(addr, out)) {
+            return true;
+        }
     }
+    return false;
 }
 
-Elf32_Word Cmd_parser::read_bits_unsigned(Elf32_Word src, size_t start, size_t end) {
-    Elf32_Word result = 0;
-    write_bits(src, start, end, result, 0);
-    return result;
+void Cmd_parser::annotate_lines(bool enable) {
+    annotate_lines_ = enable;
+}
+
+void Cmd_parser::pseudo_instructions(bool enable) {
+    pseudo_instructions_ = enable;
+}
+
+void Cmd_parser::set_profile(const Profile *profile) {
+    profile_ = profile;
 }
 
-Elf32_Word Cmd_parser::get_opcode(Elf32_Word src) {
-    return read_bits_unsigned(src, 0, 6);
+void Cmd_parser::set_cycle_model(const Cycle_model *model) {
+    cycle_model_ = model;
+}
+
+void Cmd_parser::set_source_lines(const Line_table *lines, Source_pool *sources) {
+    lines_ = lines;
+    sources_ = sources;
+}
+
+bool Cmd_parser::get_bit(Elf32_Word value, size_t pos) const {
+    return value & (1u << pos);
+}
+
+Elf32_Word Cmd_parser::read_bits_unsigned(Elf32_Word src, size_t start, size_t end) const {
+    return (src >> start) & (0xffffffffu >> (31 - (end - start)));
 }
 
 std::string Cmd_parser::get_label_name(Elf32_Addr addr) {
@@ -49,506 +106,865 @@ std::string Cmd_parser::get_label_name(Elf32_Addr addr) {
     return new_label;
 }
 
-std::pair<std::string, std::string> Cmd_parser::get_succ_pred(Elf32_Word cmd) {
-    Elf32_Word succ = read_bits_unsigned(cmd, 20, 23);
-    Elf32_Word pred = read_bits_unsigned(cmd, 24, 27);
-    std::string succ_letters = "";
-    std::string pred_letters = "";
+// Appends "<label>" of already collected branch target: symbol at the very
+// address, "func+0x<offset>" inside a sized symbol, or generated label
+void Cmd_parser::append_target(Elf32_Addr addr, std::string& out) const {
+    out += '<';
+    auto label = symtab_.find(addr);
+    if (label != symtab_.end()) {
+        out += label->second;
+    }
+    else if (!symbols_.append_location(addr, out)) {
+        out += '?';
+    }
+    out += '>';
+}
+
+// Letters of fence predecessor or successor set
+std::string Cmd_parser::get_fence_set(Elf32_Word set) const {
+    std::string letters = "";
 
-    if (get_bit(succ, 3)) {
-        succ_letters += "i";
+    if (get_bit(set, 3)) {
+        letters += "i";
     }
-    if (get_bit(succ, 2)) {
-        succ_letters += "o";
+    if (get_bit(set, 2)) {
+        letters += "o";
     }
-    if (get_bit(succ, 1)) {
-        succ_letters += "r";
+    if (get_bit(set, 1)) {
+        letters += "r";
     }
-    if (get_bit(succ, 0)) {
-        succ_letters += "w";
+    if (get_bit(set, 0)) {
+        letters += "w";
     }
+    return letters;
+}
 
-    if (get_bit(pred, 3)) {
-        pred_letters += "i";
+// Creates labels of branch and jal targets of cmd located at addr
+void Cmd_parser::collect_labels(Elf32_Word cmd, Elf32_Addr addr) {
+    const Isa_cmd *isa_cmd = isa_decode(cmd);
+    if (isa_cmd == nullptr) {
+        return;
+    }
+    for (const char *op = isa_cmd->operands; *op != '\0'; op++) {
+        Elf32_Addr target;
+        if (*op == 'p') {
+            target = addr + isa_imm_b(cmd);
+        }
+        else if (*op == 'a') {
+            target = addr + isa_imm_j(cmd);
+        }
+        else {
+            continue;
+        }
+        mark_block_start(target);
+        // Targets inside known functions are printed as func+offset
+        if (symtab_.find(target) == symtab_.end() && symbols_.find(target) == nullptr) {
+            get_label_name(target);
+        }
     }
-    if (get_bit(pred, 2)) {
-        pred_letters += "o";
+}
+
+// Labels are numbered in the order of the first reference to them,
+// so this pass goes through .text before any line is rendered.
+void Cmd_parser::collect_labels() {
+    collect_labels(std::vector<std::pair<size_t, size_t>>(1, std::make_pair(0, text_size_)));
+}
+
+void Cmd_parser::collect_labels(const std::vector<std::pair<size_t, size_t>>& ranges) {
+    block_starts_.assign(text_size_, false);
+    for (const auto& range : ranges) {
+        size_t relocation = lower_relocation(range.first);
+        for (size_t i = range.first; i < range.second; i++) {
+            // Targets of relocated commands are symbols, not the placeholder offsets
+            if (relocation < relocations_.size() && relocations_[relocation].offset == i * sizeof(Elf32_Word)) {
+                relocation++;
+                continue;
+            }
+            collect_labels(text_[i], text_start_addr_ + i * sizeof(Elf32_Word));
+        }
     }
-    if (get_bit(pred, 1)) {
-        pred_letters += "r";
+    for (const auto& symbol : symtab_) {
+        mark_block_start(symbol.first);
     }
-    if (get_bit(pred, 0)) {
-        pred_letters += "w";
+    if (cycle_model_ != nullptr) {
+        estimate_cycles(ranges);
     }
-    return std::make_pair(pred_letters, succ_letters);
 }
 
-std::vector<std::string> Cmd_parser::parse_cmds() {
-    std::vector<Elf32_Word> cmds = elf_file_.get_text();
-    std::vector<std::string> result;
-    cur_addr_ptr_ = elf_file_.get_text_start_addr();
-
-    // Parse cmds
-    for (size_t i = 0; i < cmds.size(); i++) {
-        char fmt_string[1000];
-        Elf32_Word cmd = cmds[i];
-        std::string parsed_cmd = parse_cmd(cmd);
-        sprintf(fmt_string, "   %05x:\t%08x\t%s", cur_addr_ptr_, cmd, parsed_cmd.c_str());
-        result.push_back(std::string(fmt_string));
-        cur_addr_ptr_ += 4;    // += sizeof(Elf32_Word)
+// Single pass over the commands of ranges: blocks end at jumps, branches
+// and range ends and start at their targets and at symbols. A load-use
+// stall is charged to the command after a load which reads the loaded
+// register.
+void Cmd_parser::estimate_cycles(std::vector<std::pair<size_t, size_t>> ranges) {
+    static constexpr const Isa_cmd *isa_jalr = isa_find("jalr");
+    // Functions of --function and --top may come in any order and overlap
+    std::sort(ranges.begin(), ranges.end());
+    cycle_ranges_.clear();
+    for (const auto& range : ranges) {
+        if (range.first >= range.second) {
+            continue;
+        }
+        if (!cycle_ranges_.empty() && range.first <= cycle_ranges_.back().last) {
+            cycle_ranges_.back().last = std::max(cycle_ranges_.back().last, range.second);
+        }
+        else {
+            cycle_ranges_.push_back({range.first, range.second, 0});
+        }
     }
+    cumulative_cycles_.clear();
+    block_bounds_.clear();
+    for (Cycle_range& range : cycle_ranges_) {
+        range.base = cumulative_cycles_.size();
+        cumulative_cycles_.push_back(range.base == 0 ? 0 : cumulative_cycles_.back());
+        estimate_cycles(range, isa_jalr);
+    }
+}
 
-    // Add label strings
-    std::vector<std::string>::iterator it;
-    cur_addr_ptr_ = elf_file_.get_text_start_addr();
-    size_t i = 0;
-    for (it = result.begin(); it < result.end(); it++) {
-        if (symtab_.find(cur_addr_ptr_) != symtab_.end()) {
-            char fmt_string2[1000];
-            sprintf(fmt_string2, "\n%08x \t<%s>:", cur_addr_ptr_, symtab_[cur_addr_ptr_].c_str());
-            result.insert(it, std::string(fmt_string2));
-            it++;
+void Cmd_parser::estimate_cycles(const Cycle_range& range, const Isa_cmd *isa_jalr) {
+    bool block_ended = true;
+    // Register loaded by the previous command, float registers count from 32
+    int loaded = -1;
+
+    for (size_t i = range.first; i < range.last; i++) {
+        if (block_ended || is_block_start(i)) {
+            block_bounds_.push_back(i);
+            loaded = -1;
+        }
+        Elf32_Word cmd = text_[i];
+        const Isa_cmd *isa_cmd = isa_decode(cmd);
+        uint64_t cycles = cycle_model_->cycles(isa_cmd);
+        bool stalled = false;
+        int target = -1;
+        block_ended = isa_cmd == isa_jalr;
+        for (const char *op = isa_cmd != nullptr ? isa_cmd->operands : ""; *op != '\0'; op++) {
+            switch (*op) {
+                case 's': stalled |= (int)read_rs1(cmd) == loaded; break;
+                case 't': stalled |= (int)read_rs2(cmd) == loaded; break;
+                case 'S': stalled |= (int)read_rs1(cmd) + 32 == loaded; break;
+                case 'T': stalled |= (int)read_rs2(cmd) + 32 == loaded; break;
+                case 'R': stalled |= (int)read_rs3(cmd) + 32 == loaded; break;
+                case 'd': target = read_rd(cmd) == 0 ? -1 : (int)read_rd(cmd); break;
+                case 'D': target = read_rd(cmd) + 32; break;
+                case 'p':
+                case 'a': block_ended = true; break;
+            }
         }
-        cur_addr_ptr_ += 4;
-        i++;
+        if (stalled) {
+            cycles += cycle_model_->load_use();
+        }
+        loaded = cycle_model_->is_load(isa_cmd) ? target : -1;
+        cumulative_cycles_.push_back(cumulative_cycles_.back() + cycles);
     }
+    block_bounds_.push_back(range.last);
+}
 
-    return result;
+uint64_t Cmd_parser::cycles_before(size_t idx) const {
+    auto range = std::upper_bound(cycle_ranges_.begin(), cycle_ranges_.end(), idx, [](size_t idx, const Cycle_range& range) {
+        return idx < range.first;
+    });
+    if (range == cycle_ranges_.begin()) {
+        return 0;
+    }
+    range--;
+    return cumulative_cycles_[range->base + std::min(idx, range->last) - range->first];
 }
 
-std::string Cmd_parser::parse_R_type(Elf32_Word cmd) {
-    Elf32_Word rd = read_rd(cmd);
-    Elf32_Word funct3 = read_funct3(cmd);
-    Elf32_Word rs1 = read_rs1(cmd);
-    Elf32_Word rs2 = read_rs2(cmd);
-    Elf32_Word funct2 = read_funct2(cmd);
-    Elf32_Word funct5 = read_funct5(cmd);
+// "# block: <cycles> cycles" of block_bounds_[block]
+void Cmd_parser::render_block_cycles(size_t block, std::string& out) const {
+    char fmt_string[48];
+    sprintf(fmt_string, "# block: %llu cycles\n",
+            (unsigned long long)(cycles_before(block_bounds_[block + 1]) - cycles_before(block_bounds_[block])));
+    out += fmt_string;
+}
 
-    std::string cmd_name = get_cmd_name_R_type(funct3, funct2, funct5);
+// Index of the first relocation of command idx or a later one
+size_t Cmd_parser::lower_relocation(size_t idx) const {
+    Elf32_Word offset = idx * sizeof(Elf32_Word);
+    return std::lower_bound(relocations_.begin(), relocations_.end(), offset, [](const Relocation& relocation, Elf32_Word offset) {
+        return relocation.offset < offset;
+    }) - relocations_.begin();
+}
 
-    if (cmd_name == "invalid_instruction") {
-        char fmt[1000];
-        sprintf(fmt, "%-7s", "invalid_instruction");
-        return std::string(fmt);
+size_t Cmd_parser::cmd_index(Elf32_Addr addr) const {
+    if (addr <= text_start_addr_) {
+        return 0;
     }
+    size_t idx = (addr - text_start_addr_ + sizeof(Elf32_Word) - 1) / sizeof(Elf32_Word);
+    return std::min(idx, text_size_);
+}
 
-    char fmt[1000];
-    sprintf(fmt, "%7s\t%s, %s, %s", cmd_name.c_str(), get_register(rd).c_str(), get_register(rs1).c_str(), get_register(rs2).c_str());
+void Cmd_parser::mark_block_start(Elf32_Addr addr) {
+    size_t idx = (addr - text_start_addr_) / sizeof(Elf32_Word);
+    if (addr >= text_start_addr_ && idx < block_starts_.size()) {
+        block_starts_[idx] = true;
+    }
+}
 
-    return std::string(fmt);
+bool Cmd_parser::is_block_start(size_t idx) const {
+    return idx < block_starts_.size() && block_starts_[idx];
+}
 
+size_t Cmd_parser::cmds_count() const {
+    return text_size_;
 }
 
-std::string Cmd_parser::parse_S_type(Elf32_Word cmd) {
-    Elf32_Word funct3 = read_funct3(cmd);
-    Elf32_Word rs1 = read_rs1(cmd);
-    Elf32_Word rs2 = read_rs2(cmd);
-    std::string cmd_name = get_cmd_name_S_type(funct3);
+// Every command is decoded once, the peephole stage gets decoded commands.
+// It starts a window before first, so chunks render the same as whole .text.
+void Cmd_parser::render_lines(size_t first, size_t last, std::string& out) const {
+    static constexpr const Isa_cmd *isa_lui = isa_find("lui");
+    Render_cache& cache = thread_render_cache();
+    uint64_t lookups = cache.lookups();
+    uint64_t hits = cache.hits();
+    Peephole peephole;
+    size_t warm_up = first < Peephole::window ? 0 : first - Peephole::window;
+    size_t start = pseudo_instructions_ ? warm_up : first;
+    const Isa_cmd *next_isa_cmd = start < text_size_ ? isa_decode(text_[start]) : nullptr;
+    // Merge joins with the line table and relocations, one search per call
+    size_t row = lines_ != nullptr ? lines_->lower_bound(text_start_addr_ + first * sizeof(Elf32_Word)) : 0;
+    size_t relocation = lower_relocation(start);
+    size_t block = std::lower_bound(block_bounds_.begin(), block_bounds_.end(), first) - block_bounds_.begin();
+
+    for (size_t i = start; i < last; i++) {
+        Elf32_Addr addr = text_start_addr_ + i * sizeof(Elf32_Word);
+        const Isa_cmd *isa_cmd = next_isa_cmd;
+        next_isa_cmd = i + 1 < text_size_ ? isa_decode(text_[i + 1]) : nullptr;
 
-    if (cmd_name == "invalid_instruction") {
-        char fmt[1000];
-        sprintf(fmt, "%-7s", "invalid_instruction");
-        return std::string(fmt);
+        while (relocation < relocations_.size() && relocations_[relocation].offset < i * sizeof(Elf32_Word)) {
+            relocation++;
+        }
+        bool relocated = relocation < relocations_.size() && relocations_[relocation].offset == i * sizeof(Elf32_Word);
+        size_t next_relocation = relocated ? relocation + 1 : relocation;
+        bool next_relocated = next_relocation < relocations_.size() &&
+                              relocations_[next_relocation].offset == (i + 1) * sizeof(Elf32_Word);
+
+        Pseudo pseudo = {Pseudo_kind::none, 0, 0, 0, false, 0};
+        if (pseudo_instructions_) {
+            if (is_block_start(i)) {
+                peephole.reset();
+            }
+            // Pairs never span a jump target. The value of a pair with a
+            // relocated low part only is not known, so it is not fused.
+            const Isa_cmd *pair_isa_cmd = is_block_start(i + 1) || (next_relocated && !relocated) ? nullptr : next_isa_cmd;
+            Elf32_Word next = i + 1 < text_size_ ? text_[i + 1] : 0;
+            pseudo = peephole.step(text_[i], isa_cmd, addr, next, pair_isa_cmd);
+            // A relocated lui pair loads the address of the relocation target
+            if (relocated && isa_cmd == isa_lui && pseudo.kind == Pseudo_kind::li) {
+                pseudo.kind = Pseudo_kind::la;
+            }
+            if (i < first) {
+                continue;
+            }
+        }
+
+        auto label = symtab_.find(addr);
+        if (label != symtab_.end()) {
+            render_label(label->second, addr, out);
+        }
+        if (block + 1 < block_bounds_.size() && block_bounds_[block] == i) {
+            render_block_cycles(block++, out);
+        }
+        if (lines_ != nullptr) {
+            const std::vector<Line_table::Row>& rows = lines_->rows();
+            while (row < rows.size() && rows[row].addr < addr) {
+                row++;
+            }
+            for (; row < rows.size() && rows[row].addr == addr; row++) {
+                render_source_line(rows[row], out);
+            }
+        }
+        render_line(i, isa_cmd, pseudo, relocated ? &relocations_[relocation] : nullptr, out);
     }
+    cache_lookups_ += cache.lookups() - lookups;
+    cache_hits_ += cache.hits() - hits;
+}
 
-    // Build imm
-    Elf32_Word imm = 0;
-    write_bits(cmd, 7, 11, imm, 0);
-    write_bits(cmd, 25, 31, imm, 5);
-    for (size_t i = 12; i < 32; i++) {
-        write_bits(cmd, 31, 31, imm, i);
+bool Cmd_parser::render_trace_line(Elf32_Addr addr, std::string& out) const {
+    size_t idx = (addr - text_start_addr_) / sizeof(Elf32_Word);
+    if (addr < text_start_addr_ || addr % sizeof(Elf32_Word) != 0 || idx >= text_size_) {
+        return false;
     }
-    int32_t signed_imm = imm;
+    Render_cache& cache = thread_render_cache();
+    uint64_t lookups = cache.lookups();
+    uint64_t hits = cache.hits();
+    Pseudo pseudo = {Pseudo_kind::none, 0, 0, 0, false, 0};
+    size_t relocation = lower_relocation(idx);
+    bool relocated = relocation < relocations_.size() && relocations_[relocation].offset == idx * sizeof(Elf32_Word);
+    render_line(idx, isa_decode(text_[idx]), pseudo, relocated ? &relocations_[relocation] : nullptr, out);
+    cache_lookups_ += cache.lookups() - lookups;
+    cache_hits_ += cache.hits() - hits;
+    return true;
+}
 
-    char fmt[1000];
-    sprintf(fmt, "%7s\t%s, %d(%s)", cmd_name.c_str(), get_register(rs2).c_str(), signed_imm, get_register(rs1).c_str());
-    return std::string(fmt);
+uint64_t Cmd_parser::render_cache_lookups() const {
+    return cache_lookups_;
+}
+
+uint64_t Cmd_parser::render_cache_hits() const {
+    return cache_hits_;
 }
 
-std::string Cmd_parser::parse_Fence(Elf32_Word cmd) {
-    Elf32_Word fence_bits = read_fence_bits(cmd);  // [31..20] bits
+// Appends line of command idx decoded as isa_cmd, pseudo is printed instead if any
+void Cmd_parser::render_line(size_t idx, const Isa_cmd *isa_cmd, const Pseudo& pseudo, const Relocation *relocation,
+                             std::string& out) const {
+    char fmt_string[32];
+    Elf32_Addr addr = text_start_addr_ + idx * sizeof(Elf32_Word);
 
-    if (fence_bits == 0b000000010000) {
-        char fmt[1000];
-        sprintf(fmt, "%7s", "pause");
-        return std::string(fmt);
-    }
-    else if (fence_bits == 0b100000110011) {
-        char fmt[1000];
-        sprintf(fmt, "%7s", "fence.tso");
-        return std::string(fmt);
+    if (profile_ != nullptr) {
+        uint64_t count = profile_->count(idx, idx + 1);
+        if (count == 0) {
+            out.append(7, ' ');
+        }
+        else {
+            sprintf(fmt_string, "%6.2f%%", 100.0 * count / profile_->total());
+            out += fmt_string;
+        }
     }
-    else {
-        auto pred_succ_values = get_succ_pred(cmd);
-        char fmt[1000];
-        sprintf(fmt, "%7s\t%s, %s", "fence", pred_succ_values.first.c_str(), pred_succ_values.second.c_str());
-        return std::string(fmt);
+    sprintf(fmt_string, "   %05x:\t%08x", addr, text_[idx]);
+    out += fmt_string;
+    if (pseudo.kind == Pseudo_kind::none) {
+        out += '\t';
+        render_cmd(text_[idx], isa_cmd, addr, relocation, out);
+    }
+    else if (pseudo.kind != Pseudo_kind::fused) {
+        out += '\t';
+        render_pseudo(pseudo, relocation, out);
+    }
+    // Relocation target replaces the placeholder address of jumps, branches
+    // and pseudo-instructions with an address, other commands get a comment
+    bool target_shown = pseudo.kind == Pseudo_kind::none ? isa_cmd != nullptr && strpbrk(isa_cmd->operands, "pa") != nullptr
+                                                         : pseudo.kind == Pseudo_kind::j || pseudo.kind == Pseudo_kind::call ||
+                                                           pseudo.kind == Pseudo_kind::tail || pseudo.kind == Pseudo_kind::la;
+    if (relocation != nullptr && !target_shown && pseudo.kind != Pseudo_kind::fused) {
+        out += "\t# ";
+        append_relocation(*relocation, out);
+    }
+    else if (pseudo.resolved && relocation == nullptr) {
+        out += "\t# ";
+        append_address(pseudo.address, out);
+    }
+    if (annotate_lines_) {
+        size_t line_end = out.size();
+        out += "\t# <";
+        if (symbols_.append_location(addr, out)) {
+            out += '>';
+        }
+        else {
+            out.resize(line_end);
+        }
     }
+    out += '\n';
 }
 
-std::string Cmd_parser::parse_J_type(Elf32_Word cmd) {
-    Elf32_Word rd = read_rd(cmd);
+// Appends "\n<addr> \t<label>:\n", with samples and cycles of the function
+// starting there
+void Cmd_parser::render_label(const std::string& label, Elf32_Addr addr, std::string& out) const {
+    char fmt_string[32];
+    sprintf(fmt_string, "\n%08x \t<", addr);
+    out += fmt_string;
+    out += label;
+    out += ">:";
 
-    // Build imm
-    Elf32_Word imm = 0;
-    write_bits(cmd, 12, 19, imm, 12);
-    write_bits(cmd, 20, 20, imm, 11);
-    write_bits(cmd, 21, 30, imm, 1);
-    write_bits(cmd, 31, 31, imm, 20);
-    for (size_t i = 21; i < 32; i++) {
-        write_bits(cmd, 31, 31, imm, i);
+    const Symbol_index::Symbol *symbol = symbols_.find(addr);
+    if (symbol == nullptr || symbol->start != addr || addr < text_start_addr_) {
+        out += '\n';
+        return;
     }
-    int32_t signed_imm = imm;
-    Elf32_Addr label_addr = signed_imm + cur_addr_ptr_;
-    char fmt[1000];
-    sprintf(fmt, "%7s\t%s, 0x%x <%s>", "jal", get_register(rd).c_str(), label_addr, get_label_name(label_addr).c_str());
-    return std::string(fmt);
-
+    size_t first = (addr - text_start_addr_) / sizeof(Elf32_Word);
+    size_t last = std::min(first + (symbol->size + sizeof(Elf32_Word) - 1) / sizeof(Elf32_Word), text_size_);
+    if (profile_ != nullptr) {
+        out += "\t# ";
+        append_samples(profile_->count(first, last), out);
+    }
+    if (cycle_model_ != nullptr && first < last) {
+        sprintf(fmt_string, "%llu cycles", (unsigned long long)(cycles_before(last) - cycles_before(first)));
+        out += profile_ != nullptr ? ", " : "\t# ";
+        out += fmt_string;
+    }
+    out += '\n';
 }
 
-std::string Cmd_parser::parse_U_type(Elf32_Word cmd) {
-    Elf32_Word rd = read_rd(cmd);
-    std::string cmd_name = get_cmd_name_U_type(get_opcode(cmd));
-
-    if (cmd_name == "invalid_instruction") {
-        char fmt[1000];
-        sprintf(fmt, "%-7s", "invalid_instruction");
-        return std::string(fmt);
+// "# <file>:<line>\t<source text>", without text if the file cannot be read
+void Cmd_parser::render_source_line(const Line_table::Row& row, std::string& out) const {
+    if (row.line == 0) {
+        return;
     }
+    char fmt_string[16];
+    sprintf(fmt_string, ":%u", row.line);
+    out += "# ";
+    out += lines_->files()[row.file];
+    out += fmt_string;
 
-    // Parse imm from cmd
-    Elf32_Word imm = 0;
-    write_bits(cmd, 12, 31, imm, 0);
-    int32_t signed_imm = imm;
+    const char *text;
+    size_t size;
+    if (sources_->get_line(row.file, row.line, text, size)) {
+        out += '\t';
+        out.append(text, size);
+    }
+    out += '\n';
+}
 
-    char fmt[1000];
-    sprintf(fmt, "%7s\t%s, 0x%x", cmd_name.c_str(), get_register(rd).c_str(), signed_imm);
-    return std::string(fmt);
+// Appends "<count> samples, <percent>%" of all samples
+void Cmd_parser::append_samples(uint64_t count, std::string& out) const {
+    char fmt_string[64];
+    double percent = profile_->total() == 0 ? 0.0 : 100.0 * count / profile_->total();
+    sprintf(fmt_string, "%llu samples, %.2f%%", (unsigned long long)count, percent);
+    out += fmt_string;
 }
 
-std::string Cmd_parser::parse_B_type(Elf32_Word cmd) {
-    Elf32_Word funct3 = read_funct3(cmd);
-    Elf32_Word rs1 = read_rs1(cmd);
-    Elf32_Word rs2 = read_rs2(cmd);
-    std::string cmd_name = get_cmd_name_B_type(funct3);
+std::vector<Cmd_parser::Function_range> Cmd_parser::functions() const {
+    std::vector<Function_range> functions;
+    Elf32_Addr text_end = text_start_addr_ + text_size_ * sizeof(Elf32_Word);
 
-    if (cmd_name == "invalid_instruction") {
-        char fmt[1000];
-        sprintf(fmt, "%-7s", "invalid_instruction");
-        return std::string(fmt);
+    // symbols_ holds .text symbols only; sized labels and objects placed in
+    // .text are not functions
+    for (const Symbol_index::Symbol& symbol : symbols_.symbols()) {
+        if (symbol.type != STT_FUNC || symbol.start < text_start_addr_ || symbol.start >= text_end) {
+            continue;
+        }
+        size_t first = (symbol.start - text_start_addr_) / sizeof(Elf32_Word);
+        size_t last = first + (symbol.size + sizeof(Elf32_Word) - 1) / sizeof(Elf32_Word);
+        functions.push_back({symbol.name, symbol.start, first, std::min(last, text_size_)});
     }
+    return functions;
+}
+
+std::vector<std::pair<size_t, size_t>> Cmd_parser::hottest_functions(size_t count) const {
+    struct Hot_function {
+        uint64_t samples;
+        size_t   first;
+        size_t   last;
+    };
+    std::vector<Hot_function> hot_functions;
 
-    Elf32_Word imm = 0;
-    write_bits(cmd, 8, 11, imm, 1);
-    write_bits(cmd, 25, 30, imm, 5);
-    write_bits(cmd, 7, 7, imm, 11);
-    write_bits(cmd, 31, 31, imm, 12);
-    for (size_t i = 13; i < 32; i++) {
-        write_bits(cmd, 31, 31, imm, i);
+    for (const Function_range& function : functions()) {
+        uint64_t samples = profile_ == nullptr ? 0 : profile_->count(function.first, function.last);
+        if (samples > 0) {
+            hot_functions.push_back({samples, function.first, function.last});
+        }
     }
-    int32_t signed_imm = imm;
 
-    Elf32_Addr label_addr = signed_imm + cur_addr_ptr_;
-    char fmt[1000];
-    sprintf(fmt, "%7s\t%s, %s, 0x%x, <%s>", cmd_name.c_str(), get_register(rs1).c_str(), get_register(rs2).c_str(), label_addr, get_label_name(label_addr).c_str());
-    return std::string(fmt);
+    // Equal totals keep address order
+    std::stable_sort(hot_functions.begin(), hot_functions.end(), [](const Hot_function& a, const Hot_function& b) {
+        return a.samples > b.samples;
+    });
+    if (hot_functions.size() > count) {
+        hot_functions.resize(count);
+    }
 
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (const Hot_function& function : hot_functions) {
+        ranges.push_back(std::make_pair(function.first, function.last));
+    }
+    return ranges;
 }
 
-std::string Cmd_parser::parse_I_type(Elf32_Word cmd) {
-    Elf32_Word opcode = get_opcode(cmd);
-    Elf32_Word rd = read_rd(cmd);
-    Elf32_Word funct3 = read_funct3(cmd);
-    Elf32_Word rs1 = read_rs1(cmd);
+Register_usage Cmd_parser::register_usage(size_t first, size_t last) const {
+    static constexpr const Isa_cmd *isa_sw = isa_find("sw");
+    static constexpr const Isa_cmd *isa_lw = isa_find("lw");
+    static constexpr const Isa_cmd *isa_jalr = isa_find("jalr");
+    const Elf32_Word reg_sp = 2;
 
-    Elf32_Word imm = 0;
-    write_bits(cmd, 20, 31, imm, 0);
-    for (size_t i = 12; i < 32; i++) {
-        write_bits(cmd, 31, 31, imm, i);
-    }
-    int32_t signed_imm = imm;
+    Register_usage usage;
+    Register_usage block;
+    for (size_t i = first; i < last; i++) {
+        if (i != first && is_block_start(i)) {
+            usage.add_block(block);
+            block = Register_usage();
+        }
+
+        Elf32_Word cmd = text_[i];
+        const Isa_cmd *isa_cmd = isa_decode(cmd);
+        if (isa_cmd == nullptr) {
+            continue;
+        }
+        uint32_t sources = 0;
+        uint32_t targets = 0;
+        bool ends_block = false;
+        for (const char *op = isa_cmd->operands; *op != '\0'; op++) {
+            if (*op == 's') {
+                sources |= 1u << read_rs1(cmd);
+            }
+            else if (*op == 't') {
+                sources |= 1u << read_rs2(cmd);
+            }
+            else if (*op == 'd') {
+                targets |= 1u << read_rd(cmd);
+            }
+            else if (*op == 'p' || *op == 'a') {
+                ends_block = true;
+            }
+        }
 
-    if (opcode == 0b1110011) {
-        if (rd == 0 && rs1 == 0 && funct3 == 0 && signed_imm == 0) {
-            char fmt[1000];
-            sprintf(fmt, "%7s", "ecall");
-            return std::string(fmt);
+        if (isa_cmd == isa_sw && read_rs1(cmd) == reg_sp) {
+            block.saved |= 1u << read_rs2(cmd);
+        }
+        else if (isa_cmd == isa_lw && read_rs1(cmd) == reg_sp) {
+            block.restored |= 1u << read_rd(cmd);
         }
-        else if (rd == 0 && rs1 == 0 && funct3 == 0 && signed_imm == 1) {
-            char fmt[1000];
-            sprintf(fmt, "%7s", "ebreak");
-            return std::string(fmt);
+        // zero is never really read or written
+        block.read |= sources & ~block.written & ~1u;
+        block.written |= targets & ~1u;
+
+        if (ends_block || isa_cmd == isa_jalr) {
+            usage.add_block(block);
+            block = Register_usage();
+        }
+    }
+    usage.add_block(block);
+    return usage;
+}
+
+void Cmd_parser::render_register_usage(const Function_range& function, std::string& out) const {
+    Register_usage usage = register_usage(function.first, function.last);
+    char fmt_string[32];
+    sprintf(fmt_string, "\n%08x \t<", function.start);
+    out += fmt_string;
+    out += function.name;
+    out += ">:";
+
+    out += "\n   read:      ";
+    append_registers(usage.read, out);
+    out += "\n   written:   ";
+    append_registers(usage.written, out);
+    out += "\n   clobbered: ";
+    append_registers(usage.clobbered(), out);
+    out += "\n   saved:     ";
+    append_registers(usage.preserved(), out);
+    out += '\n';
+}
+
+// Appends comma separated names of registers of the set
+void Cmd_parser::append_registers(uint32_t registers, std::string& out) const {
+    bool first = true;
+    for (Elf32_Word reg = 0; reg < 32; reg++) {
+        if (get_bit(registers, reg)) {
+            out += first ? "" : ", ";
+            out += get_register(reg);
+            first = false;
         }
     }
+    if (first) {
+        out += '-';
+    }
+}
 
-    else if (opcode == 0b1100111 && funct3 == 0) {
-        char fmt[1000];
-        sprintf(fmt, "%7s\t%s, %d(%s)", "jalr", get_register(rd).c_str(), signed_imm, get_register(rs1).c_str());
-        return std::string(fmt);
+std::vector<std::string> Cmd_parser::parse_cmds() {
+    std::vector<std::string> result;
+    collect_labels();
+
+    for (size_t i = 0; i < text_size_; i++) {
+        std::string lines;
+        render_lines(i, i + 1, lines);
+        lines.pop_back();
+
+        // Label line goes separately
+        size_t label_end = lines.find(":\n");
+        if (lines[0] == '\n' && label_end != std::string::npos) {
+            result.push_back(lines.substr(0, label_end + 1));
+            lines.erase(0, label_end + 2);
+        }
+        result.push_back(lines);
     }
+    return result;
+}
 
-    else if (opcode == 0b0010011) {
-        std::string cmd_name = get_cmd_name_I_type(opcode, funct3, read_funct5(cmd));
+std::string Cmd_parser::parse_cmd(Elf32_Word cmd, Elf32_Addr addr) {
+    std::string result;
+    collect_labels(cmd, addr);
+    render_cmd(cmd, isa_decode(cmd), addr, nullptr, result);
+    return result;
+}
 
-        if (cmd_name == "invalid_instruction") {
-            char fmt[1000];
-            sprintf(fmt, "%-7s", "invalid_instruction");
-            return std::string(fmt);
-        }
+// Appends "%7s[\t<operands>]" of cmd located at addr and decoded as isa_cmd
+void Cmd_parser::render_cmd(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr, const Relocation *relocation,
+                            std::string& out) const {
+    // Text of a command without branch target depends on its word only
+    bool cacheable = isa_cmd == nullptr || strpbrk(isa_cmd->operands, "pa") == nullptr;
+    Render_cache& cache = thread_render_cache();
+    if (cacheable && cache.append(cmd, out)) {
+        return;
+    }
+    size_t start = out.size();
+    render_uncached_cmd(cmd, isa_cmd, addr, relocation, out);
+    if (cacheable) {
+        cache.insert(cmd, out.data() + start, out.size() - start);
+    }
+}
 
-        char fmt[1000];
-        sprintf(fmt, "%7s\t%s, %s, %s", cmd_name.c_str(), get_register(rd).c_str(), get_register(rs1).c_str(), std::to_string(signed_imm).c_str());
-        return std::string(fmt);
+void Cmd_parser::render_uncached_cmd(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr, const Relocation *relocation,
+                                     std::string& out) const {
+    if (isa_cmd == nullptr) {
+        out += "invalid_instruction";
+        return;
     }
-    else if (opcode == 0b0000011) {
-        std::string cmd_name = get_cmd_name_I_type(opcode, funct3, read_funct5(cmd));
 
-        if (cmd_name == "invalid_instruction") {
-            char fmt[1000];
-            sprintf(fmt, "%-7s", "invalid_instruction");
-            return std::string(fmt);
-        }
+    // Atomics carry acquire/release bits in the mnemonic
+    static const char *aq_rl_suffixes[4] = {"", ".rl", ".aq", ".aqrl"};
+    const char *suffix = isa_cmd->ext == Isa_ext::A ? aq_rl_suffixes[read_bits_unsigned(cmd, 25, 26)] : "";
+    append_mnemonic(isa_cmd->name, suffix, out);
+
+    if (isa_cmd->operands[0] == '\0') {
+        return;
+    }
+    out += '\t';
+    for (const char *op = isa_cmd->operands; *op != '\0'; op++) {
+        render_operand(*op, cmd, addr, relocation, out);
+    }
+}
+
+// Appends "%7s" of the whole mnemonic
+void Cmd_parser::append_mnemonic(const char *name, const char *suffix, std::string& out) const {
+    size_t name_len = strlen(name) + strlen(suffix);
+    if (name_len < 7) {
+        out.append(7 - name_len, ' ');
+    }
+    out += name;
+    out += suffix;
+}
+
+// Appends "0x<addr>", followed by " <symbol+0x<offset>>" of a known symbol
+void Cmd_parser::append_address(Elf32_Addr addr, std::string& out) const {
+    char fmt[32];
+    sprintf(fmt, "0x%x", addr);
+    out += fmt;
 
-        char fmt[1000];
-        sprintf(fmt, "%7s\t%s, %d(%s)", cmd_name.c_str(), get_register(rd).c_str(), signed_imm, get_register(rs1).c_str());
-        return std::string(fmt);
+    // Sized symbols go first: data addresses share .text symbols like _edata
+    size_t end = out.size();
+    auto label = symtab_.find(addr);
+    out += " <";
+    if (symbols_.append_location(addr, out) || append_data_location(addr, out)) {
+        out += '>';
+    }
+    else if (label != symtab_.end()) {
+        out += label->second;
+        out += '>';
     }
     else {
-        char fmt[1000];
-        sprintf(fmt, "%-7s", "invalid_instruction");
-        return std::string(fmt);
-    }
-}
-
-std::string Cmd_parser::get_cmd_name_R_type(Elf32_Word funct3, Elf32_Word funct2, Elf32_Word funct5) {
-    if (funct2 == 0b0) {                    // 32I instruction
-        switch (funct3) {
-            case 0b000:
-                if (funct5 == 0b01000) {
-                    return "sub";
-                }
-                return "add";
-            case 0b001:
-                return "sll";
-            case 0b010:
-                return "slt";
-            case 0b011:
-                return "sltu";
-            case 0b100:
-                return "xor";
-            case 0b101:
-                if (funct5 == 0b01000) {
-                    return "sra";
-                }
-                return "srl";
-            case 0b110:
-                return "or";
-            case 0b111:
-                return "and";
-            default:
-                return "invalid_instruction";
-        }
-    }
-    else if (funct5 == 0b0 && funct2 == 0b1) {   // 32M instruction
-        switch (funct3) {
-            case 0b000:
-                return "mul";
-            case 0b001:
-                return "mulh";
-            case 0b010:
-                return "mulhsu";
-            case 0b011:
-                return "mulhu";
-            case 0b100:
-                return "div";
-            case 0b101:
-                return "divu";
-            case 0b110:
-                return "rem";
-            case 0b111:
-                return "remu";
-            default:
-                return "invalid_instruction";
-        }
-    }
-
-}
-
-std::string Cmd_parser::get_cmd_name_S_type(Elf32_Word funct3) {
-    switch (funct3) {
-        case 0b000:
-            return "sb";
-        case 0b001:
-            return "sh";
-        case 0b010:
-            return "sw";
+        out.resize(end);
+    }
+}
+
+// Appends "<symbol+0x<addend>>", objdump's *ABS* stands for no symbol
+void Cmd_parser::append_relocation(const Relocation& relocation, std::string& out) const {
+    out += '<';
+    out += relocation.symbol[0] != '\0' ? relocation.symbol : "*ABS*";
+    if (relocation.addend != 0) {
+        char fmt[16];
+        sprintf(fmt, relocation.addend > 0 ? "+0x%x" : "-0x%x",
+                relocation.addend > 0 ? (Elf32_Word)relocation.addend : 0u - (Elf32_Word)relocation.addend);
+        out += fmt;
+    }
+    out += '>';
+}
+
+// Address of j, call, tail and la is the relocation target if there is one
+void Cmd_parser::render_pseudo(const Pseudo& pseudo, const Relocation *relocation, std::string& out) const {
+    char fmt[32];
+
+    switch (pseudo.kind) {
+        case Pseudo_kind::nop:
+            append_mnemonic("nop", "", out);
+            break;
+        case Pseudo_kind::mv:
+            append_mnemonic("mv", "", out);
+            out += '\t';
+            out += get_register(pseudo.rd);
+            out += ", ";
+            out += get_register(pseudo.rs);
+            break;
+        case Pseudo_kind::li:
+            append_mnemonic("li", "", out);
+            sprintf(fmt, "\t%s, %d", get_register(pseudo.rd), (int32_t)pseudo.value);
+            out += fmt;
+            break;
+        case Pseudo_kind::ret:
+            append_mnemonic("ret", "", out);
+            break;
+        case Pseudo_kind::j:
+            // Jump targets have labels like the ones of jal
+            append_mnemonic("j", "", out);
+            if (relocation != nullptr) {
+                out += '\t';
+                append_relocation(*relocation, out);
+                break;
+            }
+            sprintf(fmt, "\t0x%x ", pseudo.value);
+            out += fmt;
+            append_target(pseudo.value, out);
+            break;
+        case Pseudo_kind::call:
+        case Pseudo_kind::tail:
+            append_mnemonic(pseudo.kind == Pseudo_kind::call ? "call" : "tail", "", out);
+            out += '\t';
+            if (relocation != nullptr) {
+                append_relocation(*relocation, out);
+                break;
+            }
+            append_address(pseudo.value, out);
+            break;
+        case Pseudo_kind::la:
+            append_mnemonic("la", "", out);
+            out += '\t';
+            out += get_register(pseudo.rd);
+            out += ", ";
+            if (relocation != nullptr) {
+                append_relocation(*relocation, out);
+                break;
+            }
+            append_address(pseudo.value, out);
+            break;
         default:
-            return "invalid_instruction";
-    }
-}
-
-std::string Cmd_parser::get_cmd_name_B_type(Elf32_Word funct3) {
-    switch (funct3) {
-        case 0b000:
-            return "beq";
-        case 0b001:
-            return "bne";
-        case 0b100:
-            return "blt";
-        case 0b101:
-            return "bge";
-        case 0b110:
-            return "bltu";
-        case 0b111:
-            return "bgeu";
+            break;
+    }
+}
+
+// Appends one operand of cmd, see operand layout in Isa.h
+// Branch and jal targets of a relocated command are the relocation target
+void Cmd_parser::render_operand(char op, Elf32_Word cmd, Elf32_Addr addr, const Relocation *relocation,
+                                std::string& out) const {
+    char fmt[32];
+
+    if ((op == 'p' || op == 'a') && relocation != nullptr) {
+        append_relocation(*relocation, out);
+        return;
+    }
+
+    switch (op) {
+        case 'd':
+            out += get_register(read_rd(cmd));
+            break;
+        case 's':
+            out += get_register(read_rs1(cmd));
+            break;
+        case 't':
+            out += get_register(read_rs2(cmd));
+            break;
+        case 'D':
+            out += get_fp_register(read_rd(cmd));
+            break;
+        case 'S':
+            out += get_fp_register(read_rs1(cmd));
+            break;
+        case 'T':
+            out += get_fp_register(read_rs2(cmd));
+            break;
+        case 'R':
+            out += get_fp_register(read_rs3(cmd));
+            break;
+        case 'j':
+            sprintf(fmt, "%d", isa_imm_i(cmd));
+            out += fmt;
+            break;
+        case 'q':
+            sprintf(fmt, "%d", isa_imm_s(cmd));
+            out += fmt;
+            break;
+        case '>':
+            sprintf(fmt, "%u", read_rs2(cmd));
+            out += fmt;
+            break;
+        case 'Z':
+            sprintf(fmt, "%u", read_rs1(cmd));
+            out += fmt;
+            break;
+        case 'u':
+            sprintf(fmt, "0x%x", isa_imm_u(cmd));
+            out += fmt;
+            break;
+        case 'p': {
+            Elf32_Addr label_addr = addr + isa_imm_b(cmd);
+            sprintf(fmt, "0x%x, ", label_addr);
+            out += fmt;
+            append_target(label_addr, out);
+            break;
+        }
+        case 'a': {
+            Elf32_Addr label_addr = addr + isa_imm_j(cmd);
+            sprintf(fmt, "0x%x ", label_addr);
+            out += fmt;
+            append_target(label_addr, out);
+            break;
+        }
+        case 'E':
+            out += get_csr_name(read_csr(cmd));
+            break;
+        case 'P':
+            out += get_fence_set(read_fence_pred(cmd));
+            break;
+        case 'Q':
+            out += get_fence_set(read_fence_succ(cmd));
+            break;
+        case 'm':
+            // Dynamic rounding mode is the default one and is not printed
+            if (read_funct3(cmd) != isa_rm_dynamic) {
+                out += ", ";
+                out += isa_rounding_modes[read_funct3(cmd)];
+            }
+            break;
         default:
-            return "invalid_instruction";
+            out += op;
     }
 }
 
-std::string Cmd_parser::get_cmd_name_U_type(Elf32_Word opcode) {
-    switch (opcode) {
-        case 0b0110111:
-            return "lui";
-        case 0b0010111:
-            return "auipc";
-        default:
-            return "invalid_instruction";
-    }
-}
-
-std::string Cmd_parser::get_cmd_name_I_type(Elf32_Word opcode, Elf32_Word funct3, Elf32_Word funct5) {
-    if (opcode == 0b1100111 && funct3 == 0) {
-        return "jalr";
-    }
-    else if (opcode == 0b0000011) {
-        switch (funct3) {
-            case 0b000:
-                return "lb";
-            case 0b001:
-                return "lh";
-            case 0b010:
-                return "lw";
-            case 0b100:
-                return "lbu";
-            case 0b101:
-                return "lhu";
-            default:
-                return "invalid_instruction";
-        }
-    }
-    else if (opcode == 0b0010011) {
-        switch (funct3) {
-            case 0b000:
-                return "addi";
-            case 0b010:
-                return "slti";
-            case 0b011:
-                return "sltiu";
-            case 0b100:
-                return "xori";
-            case 0b110:
-                return "ori";
-            case 0b111:
-                return "andi";
-            case 0b001:
-                return "slli";
-            case 0b101:
-                if (funct5 == 0b01000) {
-                    return "srai";
-                }
-                return "srli";
-            default:
-                return "invalid_instruction";
-        }
-    }
-}
-
-Elf32_Word Cmd_parser::read_rd(Elf32_Word cmd) {
+Elf32_Word Cmd_parser::read_rd(Elf32_Word cmd) const {
     return read_bits_unsigned(cmd, 7, 11);
 }
 
-Elf32_Word Cmd_parser::read_rs1(Elf32_Word cmd) {
+Elf32_Word Cmd_parser::read_rs1(Elf32_Word cmd) const {
     return read_bits_unsigned(cmd, 15 ,19);
 }
 
-Elf32_Word Cmd_parser::read_rs2(Elf32_Word cmd) {
+Elf32_Word Cmd_parser::read_rs2(Elf32_Word cmd) const {
     return read_bits_unsigned(cmd, 20, 24);
 }
 
-Elf32_Word Cmd_parser::read_funct3(Elf32_Word cmd) {
-    return read_bits_unsigned(cmd, 12, 14);
-}
-
-Elf32_Word Cmd_parser::read_funct2(Elf32_Word cmd) {
-    return read_bits_unsigned(cmd, 25, 26);
-}
-
-Elf32_Word Cmd_parser::read_funct5(Elf32_Word cmd) {
+Elf32_Word Cmd_parser::read_rs3(Elf32_Word cmd) const {
     return read_bits_unsigned(cmd, 27, 31);
 }
 
-Elf32_Word Cmd_parser::read_fence_bits(Elf32_Word cmd) {
-    return read_bits_unsigned(cmd, 20, 31);
+Elf32_Word Cmd_parser::read_funct3(Elf32_Word cmd) const {
+    return read_bits_unsigned(cmd, 12, 14);
 }
 
-Elf32_Word Cmd_parser::read_fence_fm(Elf32_Word cmd) {
-    return read_bits_unsigned(cmd, 28, 31);
+Elf32_Word Cmd_parser::read_csr(Elf32_Word cmd) const {
+    return read_bits_unsigned(cmd, 20, 31);
 }
 
-Elf32_Word Cmd_parser::read_fence_pred(Elf32_Word cmd) {
+Elf32_Word Cmd_parser::read_fence_pred(Elf32_Word cmd) const {
     return read_bits_unsigned(cmd, 24, 27);
 }
 
-Elf32_Word Cmd_parser::read_fence_succ(Elf32_Word cmd) {
+Elf32_Word Cmd_parser::read_fence_succ(Elf32_Word cmd) const {
     return read_bits_unsigned(cmd, 20, 23);
 }
 
-std::string Cmd_parser::parse_cmd(Elf32_Word cmd) {
-    Elf32_Word cmd_opcode = get_opcode(cmd);
-    if (cmd_opcode == 0b0110111 || cmd_opcode == 0b0010111) {
-        return parse_U_type(cmd);
-    }
-    else if (cmd_opcode == 0b1101111) {  // Only one cmd - jal
-        return parse_J_type(cmd);
-    }
-    else if (cmd_opcode == 0b1100011) {
-        return parse_B_type(cmd);
-    }
-    else if (cmd_opcode == 0b1100111 || cmd_opcode == 0b0000011 || cmd_opcode == 0b0010011 || cmd_opcode == 0b1110011) {
-        return parse_I_type(cmd);
-    }
-    else if (cmd_opcode == 0b0110011) {
-        return parse_R_type(cmd);
-    }
-    else if (cmd_opcode == 0b0100011) {
-        return parse_S_type(cmd);
-    }
-    else if (cmd_opcode == 0b0001111) {
-        return parse_Fence(cmd);
-    }
+const char* Cmd_parser::get_register(Elf32_Word reg) const {
+    static const char *names[32] = {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+        "s0",   "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+        "a6",   "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+        "s8",   "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+    };
+    return names[reg & 0x1f];
 }
 
-std::string Cmd_parser::get_register(Elf32_Word reg) {
-    switch (reg) {
-        case 0: return "zero";
-        case 1: return "ra";
-        case 2: return "sp";
-        case 3: return "gp";
-        case 4: return "tp";
-        case 5: return "t0";
-        case 6: return "t1";
-        case 7: return "t2";
-        case 8: return "s0";
-        case 9: return "s1";
-        default: {
-            if (reg <= 17) {
-                return "a" + std::to_string(reg - 10);
-            }
-            else if (reg <= 27) {
-                return "s" + std::to_string(reg - 16);
-            }
-            return "t" + std::to_string(reg - 25);
+const char* Cmd_parser::get_fp_register(Elf32_Word reg) const {
+    static const char *names[32] = {
+        "ft0", "ft1", "ft2",  "ft3",  "ft4", "ft5", "ft6",  "ft7",
+        "fs0", "fs1", "fa0",  "fa1",  "fa2", "fa3", "fa4",  "fa5",
+        "fa6", "fa7", "fs2",  "fs3",  "fs4", "fs5", "fs6",  "fs7",
+        "fs8", "fs9", "fs10", "fs11", "ft8", "ft9", "ft10", "ft11"
+    };
+    return names[reg & 0x1f];
+}
+
+std::string Cmd_parser::get_csr_name(Elf32_Word csr) const {
+    for (const Isa_csr& known : isa_csr_names) {
+        if (known.number == csr) {
+            return known.name;
         }
     }
+    char fmt[32];
+    sprintf(fmt, "0x%x", csr);
+    return std::string(fmt);
 }
@@ -0,0 +1,141 @@
+#include "Cycle_model.h"
+#include "Input_source.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Config names of Cmd_class values in order, then the penalties
+static const char *const class_names[] = {
+    "alu", "load", "store", "mul", "div", "atomic", "fpu", "fdiv", "csr", "system", "branch", "jump"
+};
+
+Cycle_model::Cycle_model() : branch_penalty_(2), load_use_(1) {
+    static_assert(sizeof(class_names) / sizeof(class_names[0]) == class_count, "class_names");
+    const uint32_t defaults[class_count] = {1, 1, 1, 3, 34, 4, 4, 20, 1, 1, 1, 1};
+    memcpy(class_cycles_, defaults, sizeof(defaults));
+
+    for (size_t i = 0; i < isa_table_size; i++) {
+        const Isa_cmd& cmd = isa_table[i];
+        const char *name = cmd.name;
+        switch (cmd.ext) {
+            case Isa_ext::M:
+                classes_[i] = strncmp(name, "mul", 3) == 0 ? Cmd_class::mul : Cmd_class::div;
+                break;
+            case Isa_ext::A:
+                classes_[i] = Cmd_class::atomic;
+                break;
+            case Isa_ext::F:
+            case Isa_ext::D:
+                if (strcmp(name, "flw") == 0 || strcmp(name, "fld") == 0) {
+                    classes_[i] = Cmd_class::load;
+                }
+                else if (strcmp(name, "fsw") == 0 || strcmp(name, "fsd") == 0) {
+                    classes_[i] = Cmd_class::store;
+                }
+                else {
+                    bool divides = strncmp(name, "fdiv", 4) == 0 || strncmp(name, "fsqrt", 5) == 0;
+                    classes_[i] = divides ? Cmd_class::fdiv : Cmd_class::fpu;
+                }
+                break;
+            case Isa_ext::Zicsr:
+                classes_[i] = Cmd_class::csr;
+                break;
+            case Isa_ext::Zifencei:
+                classes_[i] = Cmd_class::system;
+                break;
+            case Isa_ext::I:
+                switch (cmd.match & 0x7f) {
+                    case 0x03: classes_[i] = Cmd_class::load; break;
+                    case 0x23: classes_[i] = Cmd_class::store; break;
+                    case 0x63: classes_[i] = Cmd_class::branch; break;
+                    case 0x67:
+                    case 0x6f: classes_[i] = Cmd_class::jump; break;
+                    case 0x0f:
+                    case 0x73: classes_[i] = Cmd_class::system; break;
+                    default:   classes_[i] = Cmd_class::alu;
+                }
+                break;
+        }
+    }
+}
+
+void Cycle_model::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Invalid cycles file.");
+    }
+    try {
+        Input_source source(fd);
+        size_t size;
+        const char *data = source.read_all(size);
+        parse(data, size);
+    } catch (std::exception&) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+void Cycle_model::parse(const char *data, size_t size) {
+    const char *end = data + size;
+    for (size_t line = 1; data < end; line++) {
+        const char *line_end = (const char*)memchr(data, '\n', end - data);
+        line_end = line_end == nullptr ? end : line_end;
+        std::string text(data, line_end);
+        data = line_end < end ? line_end + 1 : end;
+
+        text = text.substr(0, text.find('#'));
+        char name[32];
+        char cycles_text[32];
+        char extra;
+        int fields = sscanf(text.c_str(), "%31s %31s %c", name, cycles_text, &extra);
+        if (fields <= 0) {
+            continue;
+        }
+        char *cycles_end;
+        unsigned long cycles = fields == 2 ? strtoul(cycles_text, &cycles_end, 10) : 0;
+        if (fields != 2 || *cycles_end != '\0' || cycles_text[0] == '-' || cycles > UINT16_MAX) {
+            throw std::runtime_error("Invalid cycles in line " + std::to_string(line) + ".");
+        }
+
+        if (strcmp(name, "branch_penalty") == 0) {
+            branch_penalty_ = cycles;
+            continue;
+        }
+        if (strcmp(name, "load_use") == 0) {
+            load_use_ = cycles;
+            continue;
+        }
+        size_t cmd_class = 0;
+        while (cmd_class < class_count && strcmp(name, class_names[cmd_class]) != 0) {
+            cmd_class++;
+        }
+        if (cmd_class == class_count) {
+            throw std::runtime_error("Unknown command class " + std::string(name) + " in line " + std::to_string(line) + ".");
+        }
+        class_cycles_[cmd_class] = cycles;
+    }
+}
+
+uint32_t Cycle_model::cycles(const Isa_cmd *isa_cmd) const {
+    if (isa_cmd == nullptr) {
+        return class_cycles_[(size_t)Cmd_class::alu];
+    }
+    Cmd_class cmd_class = classes_[isa_cmd - isa_table];
+    bool transfers = cmd_class == Cmd_class::branch || cmd_class == Cmd_class::jump;
+    return class_cycles_[(size_t)cmd_class] + (transfers ? branch_penalty_ : 0);
+}
+
+bool Cycle_model::is_load(const Isa_cmd *isa_cmd) const {
+    if (isa_cmd == nullptr) {
+        return false;
+    }
+    Cmd_class cmd_class = classes_[isa_cmd - isa_table];
+    return cmd_class == Cmd_class::load || cmd_class == Cmd_class::atomic;
+}
+
+uint32_t Cycle_model::load_use() const {
+    return load_use_;
+}
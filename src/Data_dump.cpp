@@ -0,0 +1,139 @@
+#include "Data_dump.h"
+#include <algorithm>
+#include <cstdio>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Bytes of a section rendered into one output buffer
+const size_t data_bytes_per_chunk = 1 << 16;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+// Row layout: " aaaaaaaa hhhhhhhh hhhhhhhh hhhhhhhh hhhhhhhh  cccccccccccccccc\n"
+const size_t row_hex_pos = 10;
+const size_t row_ascii_pos = 47;
+static_assert(row_ascii_pos + Data_dump::row_bytes + 1 == Data_dump::row_size, "row layout");
+
+void format_data_row(Elf32_Addr addr, const unsigned char *bytes, size_t size, char *out) {
+    out[0] = ' ';
+    for (int i = 0; i < 8; i++) {
+        out[1 + i] = hex_digits[(addr >> (28 - 4 * i)) & 0xf];
+    }
+    out[9] = ' ';
+    out[18] = out[27] = out[36] = out[45] = out[46] = ' ';
+    out[Data_dump::row_size - 1] = '\n';
+
+#ifdef __SSE2__
+    if (size == Data_dump::row_bytes) {
+        // All 16 bytes at once: nibbles to digits, digits above 9 move from ':' to 'a'
+        __m128i v = _mm_loadu_si128((const __m128i*)bytes);
+        __m128i low_nibble = _mm_set1_epi8(0x0f);
+        __m128i nine = _mm_set1_epi8(9);
+        __m128i zero = _mm_set1_epi8('0');
+        __m128i letter_gap = _mm_set1_epi8('a' - '0' - 10);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), low_nibble);
+        __m128i low = _mm_and_si128(v, low_nibble);
+        high = _mm_add_epi8(_mm_add_epi8(high, zero), _mm_and_si128(_mm_cmpgt_epi8(high, nine), letter_gap));
+        low = _mm_add_epi8(_mm_add_epi8(low, zero), _mm_and_si128(_mm_cmpgt_epi8(low, nine), letter_gap));
+
+        // Digit pairs in byte order, then four groups of four bytes
+        __m128i first = _mm_unpacklo_epi8(high, low);
+        __m128i second = _mm_unpackhi_epi8(high, low);
+        _mm_storel_epi64((__m128i*)(out + row_hex_pos), first);
+        _mm_storel_epi64((__m128i*)(out + row_hex_pos + 9), _mm_srli_si128(first, 8));
+        _mm_storel_epi64((__m128i*)(out + row_hex_pos + 18), second);
+        _mm_storel_epi64((__m128i*)(out + row_hex_pos + 27), _mm_srli_si128(second, 8));
+
+        // Printable ASCII is 0x20..0x7e, signed compares also drop bytes >= 0x80
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+                                          _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+        __m128i ascii = _mm_or_si128(_mm_and_si128(printable, v), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+        _mm_storeu_si128((__m128i*)(out + row_ascii_pos), ascii);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < Data_dump::row_bytes; i++) {
+        char *hex = out + row_hex_pos + 2 * i + i / 4;
+        if (i < size) {
+            hex[0] = hex_digits[bytes[i] >> 4];
+            hex[1] = hex_digits[bytes[i] & 0xf];
+            out[row_ascii_pos + i] = bytes[i] >= 0x20 && bytes[i] < 0x7f ? bytes[i] : '.';
+        }
+        else {
+            hex[0] = hex[1] = ' ';
+            out[row_ascii_pos + i] = ' ';
+        }
+    }
+}
+
+Data_dump::Data_dump(Loader& loader) : loader_(loader), sections_(loader.get_data_sections()) {
+    std::vector<Elf32_Sym> symtab = loader.get_symtab();
+
+    for (size_t s = 0; s < sections_.size(); s++) {
+        const Data_section& section = sections_[s];
+        size_t section_objects = objects_.size();
+        for (const Elf32_Sym& symbol : symtab) {
+            if (ELF32_ST_TYPE(symbol.st_info) == STT_OBJECT && symbol.st_shndx == section.index &&
+                symbol.st_value >= section.addr && symbol.st_value - section.addr < section.size) {
+                objects_.push_back(symbol);
+            }
+        }
+        std::stable_sort(objects_.begin() + section_objects, objects_.end(), [](const Elf32_Sym& a, const Elf32_Sym& b) {
+            return a.st_value < b.st_value;
+        });
+
+        // Segments between objects, split into chunks
+        size_t label = section_objects;
+        size_t first = 0;
+        while (first < section.size) {
+            size_t first_label = label;
+            while (label < objects_.size() && objects_[label].st_value - section.addr == first) {
+                label++;
+            }
+            size_t last = label < objects_.size() ? objects_[label].st_value - section.addr : section.size;
+            for (size_t pos = first; pos < last; pos += data_bytes_per_chunk) {
+                chunks_.push_back({s, pos, std::min(pos + data_bytes_per_chunk, last),
+                                   pos == first ? first_label : label, label});
+            }
+            first = last;
+        }
+    }
+}
+
+size_t Data_dump::chunks_count() const {
+    return chunks_.size();
+}
+
+void Data_dump::render_chunk(size_t chunk_idx, std::string& out) const {
+    const Chunk& chunk = chunks_[chunk_idx];
+    const Data_section& section = sections_[chunk.section];
+    if (chunk.first == 0) {
+        out += "\n\n";
+        out += section.name;
+        out += '\n';
+    }
+    for (size_t i = chunk.first_label; i < chunk.last_label; i++) {
+        char fmt_string[32];
+        sprintf(fmt_string, "\n%08x \t<", objects_[i].st_value);
+        out += fmt_string;
+        out += loader_.get_symbol_name(objects_[i].st_name);
+        out += ">:\n";
+    }
+
+    // Rows are formatted in place, a partial last row is cut after its bytes
+    size_t rows = (chunk.last - chunk.first + row_bytes - 1) / row_bytes;
+    size_t pos = out.size();
+    out.resize(pos + rows * row_size);
+    for (size_t offset = chunk.first; offset < chunk.last; offset += row_bytes) {
+        size_t size = std::min(row_bytes, chunk.last - offset);
+        format_data_row(section.addr + offset, section.data + offset, size, &out[pos]);
+        pos += row_size;
+        if (size < row_bytes) {
+            size_t end = pos - row_size + row_ascii_pos + size;
+            out[end] = '\n';
+            out.resize(end + 1);
+        }
+    }
+}
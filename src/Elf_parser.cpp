@@ -1,4 +1,5 @@
 #include "Elf_parser.h"
+#include <algorithm>
 #include <stdexcept>
 #include <cstring>
 
@@ -10,9 +11,15 @@
 #define EI_DATA  1     // little endian
 #define ISA      0xf3  // RISC-V architecture
 
-Elf_parser::Elf_parser(FILE *elf_file) {
-    elf_src_ = elf_file;
-    fread(&elf_header_, sizeof(Elf32_Ehdr), 1, elf_file);
+#define ET_REL         1    // Relocatable object file
+
+Elf_parser::Elf_parser(Input_source& source) : Elf_parser(source, 0) {}
+
+Elf_parser::Elf_parser(Input_source& source, size_t base) : source_(source), base_(base), text_data_(nullptr), text_size_(0),
+                                                             symtab_section_idx_(0), dynsym_section_idx_(0),
+                                                             text_section_idx(0), text_start_addr(0) {
+    // Input is read forward only: header, section header table, then sections
+    memcpy(&elf_header_, source_.read(base_, sizeof(Elf32_Ehdr)), sizeof(Elf32_Ehdr));
 
     if (!check_magic_bytes()) {
         throw std::runtime_error("Not an Elf file.");
@@ -30,88 +37,179 @@ Elf_parser::Elf_parser(FILE *elf_file) {
         throw std::runtime_error("Not RISC-V architecture file.");
     }
 
-    Elf32_Shdr shstrtab;
-    // e_shoff - section header table's file offset in bytes
-    // e_shstrndx - section header table index
-    fseek(elf_file, elf_header_.e_shoff + elf_header_.e_shstrndx * sizeof(Elf32_Shdr), SEEK_SET);
+    // The section header table is read and validated once, sections are
+    // then found through its indexes
+    sections_.load(source_, base_, elf_header_);
+    text_section_idx = sections_.find(".text");
+    const Elf32_Shdr& text_section_hdr = sections_.get(text_section_idx);
+    text_start_addr = text_section_hdr.sh_addr;
 
-    // reads section header
-    fread(&shstrtab, sizeof(Elf32_Shdr), 1, elf_file);
+    read_text_section(text_section_hdr);
+    symtab_section_idx_ = read_symtable_section(SHT_SYMTAB, symtab_, symbol_names_);
+    dynsym_section_idx_ = read_symtable_section(SHT_DYNSYM, dynsym_, dynsym_names_);
+}
 
-    char *section_names = new char[shstrtab.sh_size];
-    fseek(elf_file, shstrtab.sh_offset, SEEK_SET);
-    fread(section_names, shstrtab.sh_size, 1, elf_file);
-    Elf32_Shdr text_section_hdr, symtab_section_hdr, strtab_section_hdr;
+// The section table has brought the whole input up to the last section in,
+// so pointers into a pipe input stay valid
+const unsigned char* Elf_parser::read_section(const Elf32_Shdr& section_hdr) {
+    return (const unsigned char*)source_.read(base_ + section_hdr.sh_offset, section_hdr.sh_size);
+}
+
+std::vector<Data_section> Elf_parser::get_data_sections() {
+    std::vector<Data_section> sections;
+    for (size_t i = 1; i < sections_.size(); i++) {
+        const Elf32_Shdr& hdr = sections_.get(i);
+        if ((hdr.sh_flags & SHF_ALLOC) != 0 && (hdr.sh_flags & SHF_EXECINSTR) == 0 &&
+            hdr.sh_type != SHT_NOBITS && hdr.sh_size > 0) {
+            sections.push_back({sections_.get_name(i), (Elf32_Half)i, hdr.sh_addr, read_section(hdr), hdr.sh_size});
+        }
+    }
+    std::stable_sort(sections.begin(), sections.end(), [](const Data_section& a, const Data_section& b) {
+        return a.addr < b.addr;
+    });
+    return sections;
+}
 
-    // Iterate through all section headers
-    for (size_t i = 0; i < elf_header_.e_shnum; i++) {
-        Elf32_Shdr cur_section_hdr;
+const unsigned char* Elf_parser::get_section(const char *name, size_t& size) {
+    size_t idx = sections_.find(name);
+    const Elf32_Shdr& hdr = sections_.get(idx);
+    if (idx == 0 || hdr.sh_type == SHT_NOBITS) {
+        size = 0;
+        return nullptr;
+    }
+    size = hdr.sh_size;
+    return read_section(hdr);
+}
 
-        fseek(elf_file, elf_header_.e_shoff + i * sizeof(Elf32_Shdr), SEEK_SET);
-        fread(&cur_section_hdr, sizeof(Elf32_Shdr), 1, elf_file);
+bool Elf_parser::is_relocatable() {
+    return elf_header_.e_type == ET_REL;
+}
 
-        if (strcmp(section_names + cur_section_hdr.sh_name, ".text") == 0) {
-            text_section_idx = i;
-            text_start_addr = cur_section_hdr.sh_addr;
-            text_section_hdr = cur_section_hdr;
+// Markers for the linker, not bound to any symbol
+#define R_RISCV_NONE          0
+#define R_RISCV_ALIGN         43
+#define R_RISCV_RELAX         51
+// Low 12 bits of a pc-relative address, bound to the auipc with the high bits
+#define R_RISCV_PCREL_LO12_I  24
+#define R_RISCV_PCREL_LO12_S  25
+
+#define ELF32_R_SYM(info)   ((info) >> 8)
+#define ELF32_R_TYPE(info)  ((info) & 0xff)
+
+std::vector<Relocation> Elf_parser::get_text_relocations() {
+    std::vector<Relocation> relocations;
+    // Offsets of low parts and of the auipc each of them refers to
+    std::vector<std::pair<Elf32_Word, Elf32_Word>> low_parts;
+    // Relocatable objects use section offsets, linked images use addresses
+    Elf32_Addr origin = elf_header_.e_type == ET_REL ? 0 : text_start_addr;
+
+    std::vector<size_t> relocation_sections = sections_.find_type(SHT_RELA);
+    const std::vector<size_t>& rel_sections = sections_.find_type(SHT_REL);
+    relocation_sections.insert(relocation_sections.end(), rel_sections.begin(), rel_sections.end());
+    for (size_t idx : relocation_sections) {
+        const Elf32_Shdr& hdr = sections_.get(idx);
+        if (hdr.sh_info != text_section_idx || text_section_idx == 0) {
+            continue;
         }
-
-        else if (strcmp(section_names + cur_section_hdr.sh_name, ".symtab") == 0) {
-            symtab_section_hdr = cur_section_hdr;
+        const std::vector<Elf32_Sym> *symbols = nullptr;
+        if (hdr.sh_link == symtab_section_idx_ && symtab_section_idx_ != 0) {
+            symbols = &symtab_;
+        }
+        else if (hdr.sh_link == dynsym_section_idx_ && dynsym_section_idx_ != 0) {
+            symbols = &dynsym_;
         }
 
-        else if (strcmp(section_names + cur_section_hdr.sh_name, ".strtab") == 0) {
-            strtab_section_hdr = cur_section_hdr;
-
+        size_t entry_size = hdr.sh_type == SHT_RELA ? sizeof(Elf32_Rela) : sizeof(Elf32_Rel);
+        size_t count = hdr.sh_size / entry_size;
+        const unsigned char *data = read_section(hdr);
+        for (size_t i = 0; i < count; i++) {
+            Elf32_Rela rela = {};
+            memcpy(&rela, data + i * entry_size, entry_size);
+            Elf32_Word type = ELF32_R_TYPE(rela.r_info);
+            if (type == R_RISCV_NONE || type == R_RISCV_ALIGN || type == R_RISCV_RELAX) {
+                continue;
+            }
+
+            Relocation relocation = {rela.r_offset - origin, type, "", rela.r_addend};
+            Elf32_Word symbol_idx = ELF32_R_SYM(rela.r_info);
+            if (symbols != nullptr && symbol_idx != 0 && symbol_idx < symbols->size()) {
+                const Elf32_Sym& symbol = (*symbols)[symbol_idx];
+                if (ELF32_ST_TYPE(symbol.st_info) == STT_SECTION && symbol.st_shndx < sections_.size()) {
+                    relocation.symbol = sections_.get_name(symbol.st_shndx);
+                }
+                else {
+                    relocation.symbol = symbols == &symtab_ ? get_symbol_name(symbol.st_name) : get_dynsym_name(symbol.st_name);
+                }
+                if (type == R_RISCV_PCREL_LO12_I || type == R_RISCV_PCREL_LO12_S) {
+                    low_parts.push_back(std::make_pair(relocation.offset, symbol.st_value - origin));
+                }
+            }
+            relocations.push_back(relocation);
         }
     }
 
-    read_text_section(text_section_hdr);
-    read_symtable_section(symtab_section_hdr);
-    read_strtab_section(strtab_section_hdr);
-
-    delete[] section_names;
-}
-
-Elf_parser::~Elf_parser() {
-    fclose(elf_src_);
-    delete[] symbol_names_;
+    std::stable_sort(relocations.begin(), relocations.end(), [](const Relocation& a, const Relocation& b) {
+        return a.offset < b.offset;
+    });
+    relocations.erase(std::unique(relocations.begin(), relocations.end(), [](const Relocation& a, const Relocation& b) {
+        return a.offset == b.offset;
+    }), relocations.end());
+
+    // A low part shows the target of its high part rather than the auipc label
+    auto find = [&](Elf32_Word offset) -> Relocation* {
+        auto relocation = std::lower_bound(relocations.begin(), relocations.end(), offset, [](const Relocation& r, Elf32_Word offset) {
+            return r.offset < offset;
+        });
+        return relocation != relocations.end() && relocation->offset == offset ? &*relocation : nullptr;
+    };
+    for (const auto& low_part : low_parts) {
+        Relocation *low = find(low_part.first);
+        const Relocation *high = find(low_part.second);
+        if (low != nullptr && high != nullptr && (low->type == R_RISCV_PCREL_LO12_I || low->type == R_RISCV_PCREL_LO12_S)) {
+            low->symbol = high->symbol;
+            low->addend = high->addend;
+        }
+    }
+    return relocations;
 }
 
+void Elf_parser::read_text_section(const Elf32_Shdr& text_section_hdr) {
+    // Trailing bytes which do not form a whole command are ignored
+    text_size_ = text_section_hdr.sh_size / sizeof(Elf32_Word);
+    const char *text = source_.read(base_ + text_section_hdr.sh_offset, text_size_ * sizeof(Elf32_Word));
 
-void Elf_parser::read_text_section(Elf32_Shdr& text_section_hdr) {
-    Elf32_Addr command_ptr = text_section_hdr.sh_offset;
-    while (command_ptr != text_section_hdr.sh_offset + text_section_hdr.sh_size) {
-        Elf32_Word command;
-        // Go to start byte of command
-        fseek(elf_src_, command_ptr, SEEK_SET);
-        // Read command
-        fread(&command, sizeof(Elf32_Word), 1, elf_src_);
-        text_.push_back(command);
-        // Move pointer to the next command
-        command_ptr += sizeof(Elf32_Word);
+    // Mapped aligned .text is used in place: pages nobody renders are never read.
+    // Archive members are only 2-byte aligned, so the address is checked.
+    if (source_.is_mapped() && (uintptr_t)text % alignof(Elf32_Word) == 0) {
+        text_data_ = (const Elf32_Word*)text;
+        return;
     }
+    text_.resize(text_size_);
+    memcpy(text_.data(), text, text_size_ * sizeof(Elf32_Word));
+    text_data_ = text_.data();
 }
 
-void Elf_parser::read_symtable_section(Elf32_Shdr &symtable_section_hdr) {
-    // Calculate number of symbols in .symtab
-    size_t number_of_symbols = symtable_section_hdr.sh_size / sizeof(Elf32_Sym);
-    // Move pointer to the start of .symtab section
-    fseek(elf_src_, symtable_section_hdr.sh_offset, SEEK_SET);
-    symtab_.resize(number_of_symbols);
-
-    // Read every symbol
-    for (size_t i = 0; i < number_of_symbols; i++) {
-        fread(&symtab_[i], sizeof(Elf32_Sym), 1, elf_src_);
+size_t Elf_parser::read_symtable_section(Elf32_Word type, std::vector<Elf32_Sym>& symbols, std::string& names) {
+    const std::vector<size_t>& symtables = sections_.find_type(type);
+    if (symtables.empty()) {
+        return 0;
+    }
+    size_t idx = symtables.front();
+    const Elf32_Shdr& symtable_section_hdr = sections_.get(idx);
+    if (symtable_section_hdr.sh_entsize != 0 && symtable_section_hdr.sh_entsize != sizeof(Elf32_Sym)) {
+        throw std::runtime_error(std::string("Invalid symbol size of ") + sections_.get_name(idx) + ".");
+    }
+    const Elf32_Shdr& strtab_section_hdr = sections_.get(symtable_section_hdr.sh_link);
+    if (strtab_section_hdr.sh_type != SHT_STRTAB) {
+        throw std::runtime_error(std::string("No string table of ") + sections_.get_name(idx) + ".");
     }
-}
 
-void Elf_parser::read_strtab_section(Elf32_Shdr &strtab_section_hdr) {
-    symbol_names_ = new char[strtab_section_hdr.sh_size];
-    // Move pointer to the start of strtab
-    fseek(elf_src_, strtab_section_hdr.sh_offset, SEEK_SET);
-    // Read all symbol names from strtab
-    fread(symbol_names_, strtab_section_hdr.sh_size, 1, elf_src_);
+    size_t number_of_symbols = symtable_section_hdr.sh_size / sizeof(Elf32_Sym);
+    symbols.resize(number_of_symbols);
+    memcpy(symbols.data(), read_section(symtable_section_hdr), number_of_symbols * sizeof(Elf32_Sym));
+    // std::string keeps a terminating zero, so a broken last name does not run past the end
+    names.assign((const char*)read_section(strtab_section_hdr), strtab_section_hdr.sh_size);
+    return idx;
 }
 
 
@@ -165,96 +263,35 @@ Elf32_Word Elf_parser::get_text_section_idx() {
     return text_section_idx;
 }
 
-std::vector<Elf32_Word> Elf_parser::get_text() {
-    return text_;
+const Elf32_Word* Elf_parser::get_text() {
+    return text_data_;
+}
+
+size_t Elf_parser::get_text_size() {
+    return text_size_;
 }
 
 Elf32_Addr Elf_parser::get_text_start_addr() {
     return text_start_addr;
 }
 
-const char* Elf_parser::get_symbol_bind(char byte) {
-    switch (byte) {
-        case 0:
-            return "LOCAL";
-        case 1:
-            return "GLOBAL";
-        case 2:
-            return "WEAK";
-        case 10:
-            return "LOOS";
-        case 12:
-            return "HIOS";
-        case 13:
-            return "LOPROC";
-        case 15:
-            return "HIPROC";
+const char* Elf_parser::get_symbol_name(Elf32_Word st_name) {
+    if (st_name >= symbol_names_.size()) {
+        return "";
     }
+    return (symbol_names_.c_str() + st_name);
 }
 
-std::string Elf_parser::get_symbol_index(Elf32_Half ndx) {
-    switch (ndx) {
-        case 0:
-            return "UNDEF";
-        case 0xff00:
-            return "LOPROC";
-        case 0xff1f:
-            return "HIPROC";
-        case 0xff20:
-            return "LOOS";
-        case 0xff3f:
-            return "HIOS";
-        case 0xfff1:
-            return "ABS";
-        case 0xfff2:
-            return "COMMON";
-        case 0xffff:
-            return "XINDEX";
-        default:
-            return std::to_string(ndx);
-    }
+std::vector<Elf32_Sym> Elf_parser::get_dynsym() {
+    return dynsym_;
 }
 
-const char* Elf_parser::get_symbol_type(char byte) {
-    switch (byte) {
-        case 0:
-            return "NOTYPE";
-        case 1:
-            return "OBJECT";
-        case 2:
-            return "FUNC";
-        case 3:
-            return "SECTION";
-        case 4:
-            return "FILE";
-        case 5:
-            return "COMMON";
-        case 6:
-            return "TLS";
-        case 10:
-            return "LOOS";
-        case 12:
-            return "HIOS";
-        case 13:
-            return "LOPROC";
-        case 15:
-            return "HIPROC";
+const char* Elf_parser::get_dynsym_name(Elf32_Word st_name) {
+    if (st_name >= dynsym_names_.size()) {
+        return "";
     }
+    return (dynsym_names_.c_str() + st_name);
 }
-
-const char* Elf_parser::get_symbol_visibility(char byte) {
-    switch (byte) {
-        case 0:
-            return "DEFAULT";
-        case 1:
-            return "INTERNAL";
-        case 2:
-            return "HIDDEN";
-        case 3:
-            return "PROTECTED";
-    }
+const Section_table& Elf_parser::get_section_table() const {
+    return sections_;
 }
-
-const char* Elf_parser::get_symbol_name(Elf32_Word st_name) {
-    return (symbol_names_ + st_name);
-}
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "Function_index.h"
+#include "Isa.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+// File layout: header, buckets of all bands sorted by key, records, names.
+// Numbers are little-endian, as the images themselves.
+static const char index_magic[8] = {'R', 'V', 'F', 'I', 'D', 'X', '\0', '\0'};
+const Elf32_Word index_version = 1;
+
+struct Function_index::Header {
+    char       magic[8];
+    Elf32_Word version;
+    Elf32_Word signature_size;
+    Elf32_Word bands;
+    Elf32_Word functions;
+    Elf32_Word names_size;
+    Elf32_Word reserved;
+};
+
+// Band of a record: key is a hash of the band number and its slots
+struct Function_index::Bucket {
+    uint64_t   key;
+    Elf32_Word record;
+    Elf32_Word reserved;
+};
+
+struct Function_index::Record {
+    Elf32_Word object;
+    Elf32_Word function;
+    Elf32_Addr addr;
+    Elf32_Word cmds;
+    function_index::Signature signature;
+};
+
+// splitmix64 finalizer
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// Hash functions of the signature slots: (a * x + b) >> 32 with odd a
+struct Slot_hashes {
+    uint64_t a[function_index::signature_size];
+    uint64_t b[function_index::signature_size];
+
+    Slot_hashes() {
+        for (size_t i = 0; i < function_index::signature_size; i++) {
+            a[i] = mix(2 * i + 1) | 1;
+            b[i] = mix(2 * i + 2);
+        }
+    }
+};
+static const Slot_hashes slot_hashes;
+
+// Command with immediates dropped and registers reduced to zero, ra, sp and
+// any other: the isa_table entry in the low byte, 2 bits per register after it
+static uint16_t normalize_cmd(Elf32_Word cmd) {
+    const Isa_cmd *isa_cmd = isa_decode(cmd);
+    if (isa_cmd == nullptr) {
+        return 0xffff;
+    }
+    uint16_t token = isa_cmd - isa_table;
+    size_t shift = 8;
+    for (const char *op = isa_cmd->operands; *op != '\0'; op++) {
+        Elf32_Word reg;
+        if (*op == 'd') {
+            reg = (cmd >> 7) & 0x1f;
+        }
+        else if (*op == 's') {
+            reg = (cmd >> 15) & 0x1f;
+        }
+        else if (*op == 't') {
+            reg = (cmd >> 20) & 0x1f;
+        }
+        else {
+            continue;
+        }
+        token |= std::min<Elf32_Word>(reg, 3) << shift;
+        shift += 2;
+    }
+    return token;
+}
+static_assert(isa_table_size < 0xff, "normalize_cmd keeps isa_table entries in a byte");
+
+namespace function_index {
+
+bool fingerprint(const Elf32_Word *cmds, size_t count, Signature& signature) {
+    if (count < min_cmds) {
+        return false;
+    }
+    uint64_t minimums[signature_size];
+    std::fill(minimums, minimums + signature_size, UINT64_MAX);
+
+    // Shingles are a sliding window of 4 tokens of 16 bits
+    uint64_t window = 0;
+    for (size_t i = 0; i < count; i++) {
+        window = (window << 16) | normalize_cmd(cmds[i]);
+        if (i + 1 < min_cmds) {
+            continue;
+        }
+        uint64_t shingle = mix(window);
+        for (size_t slot = 0; slot < signature_size; slot++) {
+            minimums[slot] = std::min(minimums[slot], slot_hashes.a[slot] * shingle + slot_hashes.b[slot]);
+        }
+    }
+    for (size_t slot = 0; slot < signature_size; slot++) {
+        signature[slot] = minimums[slot] >> 32;
+    }
+    return true;
+}
+
+double similarity(const Signature& a, const Signature& b) {
+    size_t equal = 0;
+    for (size_t slot = 0; slot < signature_size; slot++) {
+        equal += a[slot] == b[slot];
+    }
+    return (double)equal / signature_size;
+}
+
+}  // namespace function_index
+
+static uint64_t band_key(const function_index::Signature& signature, size_t band) {
+    uint64_t key = mix(band + 1);
+    for (size_t row = 0; row < function_index::band_rows; row++) {
+        key = mix(key ^ signature[band * function_index::band_rows + row]);
+    }
+    return key;
+}
+
+Function_index_builder::Function_index_builder() : last_object_name_(0) {}
+
+Elf32_Word Function_index_builder::add_name(const std::string& name) {
+    Elf32_Word offset = names_.size();
+    names_ += name;
+    names_ += '\0';
+    return offset;
+}
+
+void Function_index_builder::add(const std::string& object, const std::string& function, Elf32_Addr addr, size_t cmds,
+                                 const function_index::Signature& signature) {
+    if (records_.empty() || object != last_object_) {
+        last_object_ = object;
+        last_object_name_ = add_name(object);
+    }
+    records_.push_back({last_object_name_, add_name(function), addr, (Elf32_Word)cmds, signature});
+}
+
+size_t Function_index_builder::size() const {
+    return records_.size();
+}
+
+void Function_index_builder::write(const std::string& path) const {
+    static_assert(sizeof(Function_index::Header) % 8 == 0 && sizeof(Function_index::Bucket) % 8 == 0, "index layout");
+    static_assert(sizeof(Record) == sizeof(Function_index::Record), "builder writes index records");
+
+    std::vector<Function_index::Bucket> buckets;
+    buckets.reserve(records_.size() * function_index::bands);
+    for (size_t i = 0; i < records_.size(); i++) {
+        for (size_t band = 0; band < function_index::bands; band++) {
+            buckets.push_back({band_key(records_[i].signature, band), (Elf32_Word)i, 0});
+        }
+    }
+    std::sort(buckets.begin(), buckets.end(), [](const Function_index::Bucket& a, const Function_index::Bucket& b) {
+        return a.key < b.key || (a.key == b.key && a.record < b.record);
+    });
+
+    Function_index::Header header = {};
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version = index_version;
+    header.signature_size = function_index::signature_size;
+    header.bands = function_index::bands;
+    header.functions = records_.size();
+    header.names_size = names_.size();
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Can't write index " + path + ".");
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(buckets.data(), sizeof(buckets[0]), buckets.size(), file) == buckets.size() &&
+                   fwrite(records_.data(), sizeof(records_[0]), records_.size(), file) == records_.size() &&
+                   fwrite(names_.data(), 1, names_.size(), file) == names_.size();
+    if (fclose(file) != 0 || !written) {
+        throw std::runtime_error("Can't write index " + path + ".");
+    }
+}
+
+Function_index::Function_index(const std::string& path) : file_(open(path.c_str(), O_RDONLY)) {
+    if (file_ < 0) {
+        throw std::runtime_error("Can't read index " + path + ".");
+    }
+    try {
+        source_.reset(new Input_source(file_));
+        size_t size;
+        const char *data = source_->read_all(size);
+        header_ = (const Header*)data;
+        if (size < sizeof(Header) || memcmp(header_->magic, index_magic, sizeof(index_magic)) != 0) {
+            throw std::runtime_error(path + " is not a function index.");
+        }
+        if (header_->version != index_version || header_->signature_size != function_index::signature_size ||
+            header_->bands != function_index::bands) {
+            throw std::runtime_error("Unsupported function index " + path + ".");
+        }
+        size_t buckets_size = (size_t)header_->functions * header_->bands * sizeof(Bucket);
+        size_t records_size = (size_t)header_->functions * sizeof(Record);
+        if (size != sizeof(Header) + buckets_size + records_size + header_->names_size) {
+            throw std::runtime_error("Truncated function index " + path + ".");
+        }
+        buckets_ = (const Bucket*)(data + sizeof(Header));
+        records_ = (const Record*)(data + sizeof(Header) + buckets_size);
+        names_ = data + sizeof(Header) + buckets_size + records_size;
+        names_size_ = header_->names_size;
+    } catch (std::exception&) {
+        source_.reset();
+        close(file_);
+        throw;
+    }
+}
+
+Function_index::~Function_index() {
+    source_.reset();
+    close(file_);
+}
+
+size_t Function_index::size() const {
+    return header_->functions;
+}
+
+const char* Function_index::get_name(Elf32_Word offset) const {
+    if (offset >= names_size_ || memchr(names_ + offset, 0, names_size_ - offset) == nullptr) {
+        return "";
+    }
+    return names_ + offset;
+}
+
+std::vector<Function_index::Match> Function_index::query(const function_index::Signature& signature,
+                                                         double min_similarity, size_t max_matches) const {
+    const Bucket *buckets_end = buckets_ + (size_t)header_->functions * header_->bands;
+    std::vector<Elf32_Word> candidates;
+    for (size_t band = 0; band < function_index::bands; band++) {
+        uint64_t key = band_key(signature, band);
+        const Bucket *bucket = std::lower_bound(buckets_, buckets_end, key, [](const Bucket& bucket, uint64_t key) {
+            return bucket.key < key;
+        });
+        for (; bucket != buckets_end && bucket->key == key; bucket++) {
+            candidates.push_back(bucket->record);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<Match> matches;
+    for (Elf32_Word candidate : candidates) {
+        if (candidate >= header_->functions) {
+            continue;
+        }
+        const Record& record = records_[candidate];
+        double similarity = function_index::similarity(signature, record.signature);
+        if (similarity >= min_similarity) {
+            matches.push_back({get_name(record.object), get_name(record.function), record.addr, record.cmds, similarity});
+        }
+    }
+    // Equal similarity keeps index order
+    std::stable_sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        return a.similarity > b.similarity;
+    });
+    if (matches.size() > max_matches) {
+        matches.resize(max_matches);
+    }
+    return matches;
+}
@@ -0,0 +1,338 @@
+#include "Image_loader.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+// st_shndx of all symbols of a flat image
+const Elf32_Half image_section_idx = 1;
+
+// Values of hex digits, -1 for other characters
+struct Hex_table {
+    signed char values[256];
+
+    Hex_table() {
+        memset(values, -1, sizeof(values));
+        for (int i = 0; i < 10; i++) {
+            values['0' + i] = i;
+        }
+        for (int i = 0; i < 6; i++) {
+            values['a' + i] = values['A' + i] = 10 + i;
+        }
+    }
+};
+static const Hex_table hex_table;
+
+Image_loader::Image_loader() : text_start_addr_(0) {}
+
+void Image_loader::set_image(const unsigned char *bytes, size_t size, Elf32_Addr start_addr) {
+    char message[96];
+    if (start_addr % sizeof(Elf32_Word) != 0) {
+        sprintf(message, "Image address 0x%x is not word aligned.", start_addr);
+        throw std::runtime_error(message);
+    }
+    if ((uint64_t)start_addr + size > (uint64_t)UINT32_MAX + 1) {
+        sprintf(message, "Image of %zu bytes at 0x%x is past the 32-bit address space.", size, start_addr);
+        throw std::runtime_error(message);
+    }
+    text_.assign((size + sizeof(Elf32_Word) - 1) / sizeof(Elf32_Word), 0);
+    if (size > 0) {
+        memcpy(text_.data(), bytes, size);
+    }
+    text_start_addr_ = start_addr;
+}
+
+void Image_loader::load_map(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Invalid map file.");
+    }
+    std::string map;
+    try {
+        Input_source source(fd);
+        size_t size;
+        const char *data = source.read_all(size);
+        map.assign(data, size);
+    } catch (std::exception&) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+
+    struct Map_symbol {
+        Elf32_Addr  addr;
+        Elf32_Word  size;
+        bool        has_size;
+        char        type;
+        std::string name;
+    };
+    std::vector<Map_symbol> symbols;
+    size_t line_start = 0;
+    size_t line_number = 0;
+    while (line_start < map.size()) {
+        size_t line_end = map.find('\n', line_start);
+        if (line_end == std::string::npos) {
+            line_end = map.size();
+        }
+        line_number++;
+
+        // Whitespace separated fields
+        std::vector<std::string> fields;
+        size_t pos = line_start;
+        while (pos < line_end) {
+            while (pos < line_end && isspace((unsigned char)map[pos])) {
+                pos++;
+            }
+            size_t field_end = pos;
+            while (field_end < line_end && !isspace((unsigned char)map[field_end])) {
+                field_end++;
+            }
+            if (field_end > pos) {
+                fields.push_back(map.substr(pos, field_end - pos));
+            }
+            pos = field_end;
+        }
+        line_start = line_end + 1;
+        if (fields.empty() || fields[0][0] == '#') {
+            continue;
+        }
+        // Undefined symbols of nm output have no address: "U name"
+        if (fields.size() == 2 && fields[0].size() == 1 && strchr("Uwv", fields[0][0]) != nullptr) {
+            continue;
+        }
+
+        Map_symbol symbol = {0, 0, false, 'T', fields.back()};
+        char *end;
+        symbol.addr = strtoul(fields[0].c_str(), &end, 16);
+        bool valid = *end == '\0' && fields.size() >= 2 && fields.size() <= 4;
+        if (fields.size() == 4) {
+            symbol.size = strtoul(fields[1].c_str(), &end, 16);
+            symbol.has_size = true;
+            valid = valid && *end == '\0';
+        }
+        if (fields.size() >= 3) {
+            valid = valid && fields[fields.size() - 2].size() == 1;
+            symbol.type = fields[fields.size() - 2][0];
+        }
+        if (!valid) {
+            throw std::runtime_error("Invalid map file line " + std::to_string(line_number) + ".");
+        }
+        symbols.push_back(symbol);
+    }
+
+    std::stable_sort(symbols.begin(), symbols.end(), [](const Map_symbol& a, const Map_symbol& b) {
+        return a.addr < b.addr;
+    });
+    // 2^32 for an image at the top of the address space
+    uint64_t image_end = (uint64_t)text_start_addr_ + text_.size() * sizeof(Elf32_Word);
+
+    // Symbol 0 is the null symbol, like in ELF
+    symtab_.assign(1, Elf32_Sym());
+    symbol_names_.assign(1, '\0');
+    for (size_t i = 0; i < symbols.size(); i++) {
+        Map_symbol& symbol = symbols[i];
+        if (!symbol.has_size) {
+            size_t next = i + 1;
+            while (next < symbols.size() && symbols[next].addr == symbol.addr) {
+                next++;
+            }
+            uint64_t end_addr = next < symbols.size() ? symbols[next].addr : std::max<uint64_t>(image_end, symbol.addr);
+            symbol.size = end_addr - symbol.addr;
+        }
+        bool function = strchr("tTwW", symbol.type) != nullptr;
+        bool inside = symbol.addr >= text_start_addr_ && symbol.addr < image_end;
+
+        Elf32_Sym sym = {};
+        sym.st_name = symbol_names_.size();
+        sym.st_value = symbol.addr;
+        sym.st_size = symbol.size;
+        sym.st_info = ELF32_ST_INFO(STB_GLOBAL, function ? STT_FUNC : STT_OBJECT);
+        sym.st_shndx = inside ? image_section_idx : 0xfff1;
+        symtab_.push_back(sym);
+        symbol_names_ += symbol.name;
+        symbol_names_ += '\0';
+    }
+}
+
+std::vector<Elf32_Sym> Image_loader::get_symtab() {
+    return symtab_;
+}
+
+Elf32_Word Image_loader::get_text_section_idx() {
+    return image_section_idx;
+}
+
+const Elf32_Word* Image_loader::get_text() {
+    return text_.data();
+}
+
+size_t Image_loader::get_text_size() {
+    return text_.size();
+}
+
+Elf32_Addr Image_loader::get_text_start_addr() {
+    return text_start_addr_;
+}
+
+const char* Image_loader::get_symbol_name(Elf32_Word st_name) {
+    if (st_name >= symbol_names_.size()) {
+        return "";
+    }
+    return symbol_names_.c_str() + st_name;
+}
+
+std::vector<Elf32_Sym> Image_loader::get_dynsym() {
+    return std::vector<Elf32_Sym>();
+}
+
+const char* Image_loader::get_dynsym_name(Elf32_Word) {
+    return "";
+}
+
+std::vector<Data_section> Image_loader::get_data_sections() {
+    return std::vector<Data_section>();
+}
+
+const unsigned char* Image_loader::get_section(const char*, size_t& size) {
+    size = 0;
+    return nullptr;
+}
+
+std::vector<Relocation> Image_loader::get_text_relocations() {
+    return std::vector<Relocation>();
+}
+
+bool Image_loader::is_relocatable() {
+    return false;
+}
+
+Bin_loader::Bin_loader(Input_source& source, Elf32_Addr base_addr) {
+    size_t size;
+    const char *data = source.read_all(size);
+    set_image((const unsigned char*)data, size, base_addr);
+}
+
+// Largest run of zeros filled in between data records
+const uint64_t max_hex_gap = 16 << 20;
+
+// Records are decoded straight from the mapped or read input, two hex digits
+// per byte through a lookup table. Data goes to one buffer first, the image
+// is assembled once all addresses are known.
+Hex_loader::Hex_loader(Input_source& source) {
+    struct Record {
+        Elf32_Addr addr;
+        size_t     offset;
+        size_t     size;
+    };
+    std::vector<Record> records;
+    std::vector<unsigned char> data;
+
+    size_t size;
+    const unsigned char *pos = (const unsigned char*)source.read_all(size);
+    const unsigned char *end = pos + size;
+    Elf32_Addr base = 0;
+    size_t line = 0;
+    bool eof_record = false;
+    unsigned char bytes[5 + 255];
+
+    while (pos < end && !eof_record) {
+        if (*pos == '\n' || *pos == '\r' || *pos == ' ' || *pos == '\t') {
+            line += *pos == '\n';
+            pos++;
+            continue;
+        }
+        if (*pos != ':') {
+            throw std::runtime_error("Invalid HEX record at line " + std::to_string(line + 1) + ".");
+        }
+        pos++;
+
+        // Length, address, type, data and checksum bytes
+        size_t count = 0;
+        size_t record_size = 5;
+        unsigned char checksum = 0;
+        while (count < record_size) {
+            int high = end - pos >= 2 ? hex_table.values[pos[0]] : -1;
+            int low = end - pos >= 2 ? hex_table.values[pos[1]] : -1;
+            if (high < 0 || low < 0) {
+                throw std::runtime_error("Invalid HEX record at line " + std::to_string(line + 1) + ".");
+            }
+            bytes[count] = high << 4 | low;
+            checksum += bytes[count];
+            if (count == 0) {
+                record_size = 5 + bytes[0];
+            }
+            count++;
+            pos += 2;
+        }
+        if (checksum != 0) {
+            throw std::runtime_error("HEX checksum mismatch at line " + std::to_string(line + 1) + ".");
+        }
+
+        size_t length = bytes[0];
+        Elf32_Addr offset = bytes[1] << 8 | bytes[2];
+        const unsigned char *payload = bytes + 4;
+        if ((bytes[3] == 0x02 || bytes[3] == 0x04) && length != 2) {
+            throw std::runtime_error("Invalid HEX record at line " + std::to_string(line + 1) + ".");
+        }
+        switch (bytes[3]) {
+            case 0x00:
+                if ((uint64_t)base + offset + length > (uint64_t)UINT32_MAX + 1) {
+                    throw std::runtime_error("HEX record at line " + std::to_string(line + 1) +
+                                             " is past the 32-bit address space.");
+                }
+                records.push_back({base + offset, data.size(), length});
+                data.insert(data.end(), payload, payload + length);
+                break;
+            case 0x01:
+                eof_record = true;
+                break;
+            case 0x02:
+                base = (payload[0] << 8 | payload[1]) << 4;
+                break;
+            case 0x04:
+                base = (payload[0] << 8 | payload[1]) << 16;
+                break;
+            case 0x03:
+            case 0x05:
+                // Start address is not needed for disassembly
+                break;
+            default:
+                throw std::runtime_error("Unknown HEX record type at line " + std::to_string(line + 1) + ".");
+        }
+    }
+
+    if (records.empty()) {
+        set_image(nullptr, 0, 0);
+        return;
+    }
+
+    // Image is one zero-filled buffer, so records far apart, e.g. flash and
+    // RAM, would allocate the whole space between them
+    std::vector<std::pair<uint64_t, uint64_t>> spans;
+    for (const Record& record : records) {
+        spans.push_back(std::make_pair(record.addr, (uint64_t)record.addr + record.size));
+    }
+    std::sort(spans.begin(), spans.end());
+    uint64_t last = spans[0].second;
+    for (const std::pair<uint64_t, uint64_t>& span : spans) {
+        if (span.first > last + max_hex_gap) {
+            char message[128];
+            sprintf(message, "HEX records at 0x%llx and 0x%llx are too far apart, split the image.",
+                    (unsigned long long)last, (unsigned long long)span.first);
+            throw std::runtime_error(message);
+        }
+        last = std::max(last, span.second);
+    }
+
+    // Commands are words, so the image starts at a word boundary
+    Elf32_Addr first = spans[0].first & ~(Elf32_Addr)3;
+    std::vector<unsigned char> image(last - first, 0);
+    for (const Record& record : records) {
+        memcpy(image.data() + (record.addr - first), data.data() + record.offset, record.size);
+    }
+    set_image(image.data(), image.size(), first);
+}
@@ -0,0 +1,82 @@
+#include "Input_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Size of one read() from a non-seekable input
+const size_t read_block_size = 1 << 20;
+
+Input_source::Input_source(int fd) : fd_(fd), mapped_(nullptr), mapped_size_(0), eof_(false) {
+    struct stat st;
+    if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (mapped != MAP_FAILED) {
+            mapped_ = (const char*)mapped;
+            mapped_size_ = st.st_size;
+        }
+    }
+}
+
+Input_source::~Input_source() {
+    if (mapped_ != nullptr) {
+        munmap((void*)mapped_, mapped_size_);
+    }
+}
+
+bool Input_source::is_mapped() const {
+    return mapped_ != nullptr;
+}
+
+const char* Input_source::read(size_t offset, size_t size) {
+    if (mapped_ != nullptr) {
+        if (offset > mapped_size_ || size > mapped_size_ - offset) {
+            throw std::runtime_error("Unexpected end of file.");
+        }
+        return mapped_ + offset;
+    }
+
+    fill(offset + size);
+    if (offset + size > buffer_.size()) {
+        throw std::runtime_error("Unexpected end of file.");
+    }
+    return buffer_.data() + offset;
+}
+
+const char* Input_source::read_all(size_t& size) {
+    if (mapped_ != nullptr) {
+        size = mapped_size_;
+        return mapped_;
+    }
+    fill(SIZE_MAX);
+    size = buffer_.size();
+    return buffer_.data();
+}
+
+// Reads forward until the first end bytes have arrived or input is over
+void Input_source::fill(size_t end) {
+    while (buffer_.size() < end && !eof_) {
+        size_t old_size = buffer_.size();
+        // Blocks grow with the buffer, so reading to an unknown end stays linear
+        size_t block = std::max(read_block_size, std::min(end - old_size, old_size));
+        buffer_.resize(old_size + block);
+
+        ssize_t got = ::read(fd_, buffer_.data() + old_size, block);
+        if (got < 0 && errno == EINTR) {
+            got = 0;
+        }
+        else if (got < 0) {
+            buffer_.resize(old_size);
+            throw std::runtime_error(std::string("Read error: ") + strerror(errno));
+        }
+        else if (got == 0) {
+            eof_ = true;
+        }
+        buffer_.resize(old_size + got);
+    }
+}
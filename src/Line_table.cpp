@@ -0,0 +1,367 @@
+#include "Line_table.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+// Standard opcodes of line programs
+#define DW_LNS_copy                1
+#define DW_LNS_advance_pc          2
+#define DW_LNS_advance_line        3
+#define DW_LNS_set_file            4
+#define DW_LNS_const_add_pc        8
+#define DW_LNS_fixed_advance_pc    9
+// Extended opcodes
+#define DW_LNE_end_sequence        1
+#define DW_LNE_set_address         2
+#define DW_LNE_define_file         3
+// Contents of DWARF 5 directory and file entries
+#define DW_LNCT_path               1
+#define DW_LNCT_directory_index    2
+// Attribute forms used by DWARF 5 entries
+#define DW_FORM_data2              0x05
+#define DW_FORM_data4              0x06
+#define DW_FORM_data8              0x07
+#define DW_FORM_string             0x08
+#define DW_FORM_block              0x09
+#define DW_FORM_data1              0x0b
+#define DW_FORM_strp               0x0e
+#define DW_FORM_udata              0x0f
+#define DW_FORM_data16             0x1e
+#define DW_FORM_line_strp          0x1f
+
+// Bounds-checked little-endian reader of a debug section
+class Dwarf_reader {
+public:
+    Dwarf_reader(const unsigned char *data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+    size_t offset() const {
+        return pos_;
+    }
+
+    bool at_end() const {
+        return pos_ >= size_;
+    }
+
+    void seek(size_t offset) {
+        if (offset > size_) {
+            throw std::runtime_error("Malformed .debug_line.");
+        }
+        pos_ = offset;
+    }
+
+    void skip(uint64_t size) {
+        need(size);
+        pos_ += size;
+    }
+
+    // Unsigned value of size bytes
+    uint64_t fixed(size_t size) {
+        need(size);
+        uint64_t value = 0;
+        for (size_t i = 0; i < size; i++) {
+            value |= (uint64_t)data_[pos_ + i] << (8 * i);
+        }
+        pos_ += size;
+        return value;
+    }
+
+    uint64_t uleb() {
+        uint64_t value = 0;
+        for (size_t shift = 0;; shift += 7) {
+            need(1);
+            unsigned char byte = data_[pos_++];
+            if (shift < 64) {
+                value |= (uint64_t)(byte & 0x7f) << shift;
+            }
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    int64_t sleb() {
+        uint64_t value = 0;
+        for (size_t shift = 0;; shift += 7) {
+            need(1);
+            unsigned char byte = data_[pos_++];
+            if (shift < 64) {
+                value |= (uint64_t)(byte & 0x7f) << shift;
+            }
+            if ((byte & 0x80) == 0) {
+                if (shift + 7 < 64 && (byte & 0x40) != 0) {
+                    value |= ~(uint64_t)0 << (shift + 7);
+                }
+                return (int64_t)value;
+            }
+        }
+    }
+
+    // Zero-terminated string, which must end inside the section
+    const char* str() {
+        const void *end = pos_ < size_ ? memchr(data_ + pos_, 0, size_ - pos_) : nullptr;
+        if (end == nullptr) {
+            throw std::runtime_error("Malformed .debug_line.");
+        }
+        const char *value = (const char*)data_ + pos_;
+        pos_ = (const unsigned char*)end - data_ + 1;
+        return value;
+    }
+
+private:
+    const unsigned char *data_;
+    size_t size_;
+    size_t pos_;
+
+    void need(uint64_t size) const {
+        if (size > size_ - pos_) {
+            throw std::runtime_error("Malformed .debug_line.");
+        }
+    }
+};
+
+// String at offset of a string section
+static const char* section_string(const unsigned char *data, size_t size, uint64_t offset) {
+    if (data == nullptr || offset >= size || memchr(data + offset, 0, size - offset) == nullptr) {
+        throw std::runtime_error("Invalid string offset in .debug_line.");
+    }
+    return (const char*)data + offset;
+}
+
+static std::string join_path(const std::string& dir, const std::string& name) {
+    if (dir.empty() || name[0] == '/') {
+        return name;
+    }
+    return dir + "/" + name;
+}
+
+Line_table::Line_table(Loader& loader) {
+    size_t size, line_str_size, str_size;
+    const unsigned char *data = loader.get_section(".debug_line", size);
+    const unsigned char *line_str = loader.get_section(".debug_line_str", line_str_size);
+    const unsigned char *str = loader.get_section(".debug_str", str_size);
+    if (data == nullptr) {
+        return;
+    }
+    if (loader.is_relocatable()) {
+        throw std::runtime_error("Source lines of a relocatable object are not supported, link it first.");
+    }
+
+    std::map<std::string, uint32_t> file_ids;
+    auto file_id = [&](const std::string& path) {
+        auto file = file_ids.insert(std::make_pair(path, (uint32_t)files_.size()));
+        if (file.second) {
+            files_.push_back(path);
+        }
+        return file.first->second;
+    };
+
+    Dwarf_reader section(data, size);
+    while (!section.at_end()) {
+        // Unit header, 64-bit DWARF has an escape before the length
+        uint64_t length = section.fixed(4);
+        bool dwarf64 = length == 0xffffffff;
+        if (dwarf64) {
+            length = section.fixed(8);
+        }
+        else if (length >= 0xfffffff0) {
+            throw std::runtime_error("Malformed .debug_line.");
+        }
+        size_t unit_start = section.offset();
+        section.skip(length);
+        Dwarf_reader unit(data + unit_start, length);
+        size_t offset_size = dwarf64 ? 8 : 4;
+
+        uint64_t version = unit.fixed(2);
+        if (version < 2 || version > 5) {
+            throw std::runtime_error("Unsupported .debug_line version " + std::to_string(version) + ".");
+        }
+        if (version >= 5) {
+            // Address and segment selector sizes
+            unit.skip(2);
+        }
+        uint64_t header_length = unit.fixed(offset_size);
+        size_t program_start = unit.offset() + header_length;
+        uint64_t min_inst_length = unit.fixed(1);
+        if (version >= 4) {
+            // Maximum operations per instruction, 1 for non-VLIW
+            unit.skip(1);
+        }
+        unit.skip(1);   // default_is_stmt
+        int line_base = (int8_t)unit.fixed(1);
+        uint64_t line_range = unit.fixed(1);
+        uint64_t opcode_base = unit.fixed(1);
+        if (line_range == 0 || opcode_base == 0) {
+            throw std::runtime_error("Malformed .debug_line.");
+        }
+        std::vector<uint64_t> opcode_lengths(opcode_base - 1);
+        for (uint64_t& opcode_length : opcode_lengths) {
+            opcode_length = unit.fixed(1);
+        }
+
+        // Directories and files of the unit, files as ids of files_
+        std::vector<std::string> dirs;
+        std::vector<uint32_t> unit_files;
+        if (version >= 5) {
+            // Directory 0 and file 0 are the unit's own
+            for (int table = 0; table < 2; table++) {
+                std::vector<std::pair<uint64_t, uint64_t>> formats(unit.fixed(1));
+                for (auto& format : formats) {
+                    format.first = unit.uleb();
+                    format.second = unit.uleb();
+                }
+                uint64_t count = unit.uleb();
+                for (uint64_t i = 0; i < count; i++) {
+                    std::string path;
+                    uint64_t dir = 0;
+                    for (const auto& format : formats) {
+                        const char *text = nullptr;
+                        uint64_t value = 0;
+                        switch (format.second) {
+                            case DW_FORM_string:    text = unit.str(); break;
+                            case DW_FORM_line_strp: text = section_string(line_str, line_str_size, unit.fixed(offset_size)); break;
+                            case DW_FORM_strp:      text = section_string(str, str_size, unit.fixed(offset_size)); break;
+                            case DW_FORM_udata:     value = unit.uleb(); break;
+                            case DW_FORM_data1:     value = unit.fixed(1); break;
+                            case DW_FORM_data2:     value = unit.fixed(2); break;
+                            case DW_FORM_data4:     value = unit.fixed(4); break;
+                            case DW_FORM_data8:     value = unit.fixed(8); break;
+                            case DW_FORM_data16:    unit.skip(16); break;
+                            case DW_FORM_block:     unit.skip(unit.uleb()); break;
+                            default:
+                                throw std::runtime_error("Unsupported form in .debug_line.");
+                        }
+                        if (format.first == DW_LNCT_path && text != nullptr) {
+                            path = text;
+                        }
+                        else if (format.first == DW_LNCT_directory_index) {
+                            dir = value;
+                        }
+                    }
+                    if (table == 0) {
+                        dirs.push_back(path);
+                    }
+                    else {
+                        unit_files.push_back(file_id(join_path(dir < dirs.size() ? dirs[dir] : "", path)));
+                    }
+                }
+            }
+        }
+        else {
+            // Directory 0 is the compilation directory, which is not recorded
+            // here. Files count from 1.
+            dirs.push_back("");
+            for (const char *dir = unit.str(); *dir != '\0'; dir = unit.str()) {
+                dirs.push_back(dir);
+            }
+            unit_files.push_back(UINT32_MAX);
+            for (const char *name = unit.str(); *name != '\0'; name = unit.str()) {
+                uint64_t dir = unit.uleb();
+                unit.uleb();    // modification time
+                unit.uleb();    // file size
+                unit_files.push_back(file_id(join_path(dir < dirs.size() ? dirs[dir] : "", name)));
+            }
+        }
+
+        // Line program: rows go to rows_ as they are emitted. Within a sequence
+        // a row replaces an earlier one at the same address, and a row on the
+        // line of the previous row is dropped.
+        unit.seek(program_start);
+        size_t sequence_start = rows_.size();
+        Elf32_Addr addr = 0;
+        uint64_t file = 1;
+        int64_t line = 1;
+        auto emit = [&]() {
+            Row row = {addr, 0, 0};
+            if (file < unit_files.size() && unit_files[file] != UINT32_MAX && line > 0) {
+                row.file = unit_files[file];
+                row.line = line;
+            }
+            if (rows_.size() > sequence_start && rows_.back().addr == addr) {
+                rows_.pop_back();
+            }
+            if (rows_.size() > sequence_start && rows_.back().file == row.file && rows_.back().line == row.line) {
+                return;
+            }
+            rows_.push_back(row);
+        };
+
+        while (!unit.at_end()) {
+            uint64_t opcode = unit.fixed(1);
+            if (opcode >= opcode_base) {
+                uint64_t adjusted = opcode - opcode_base;
+                addr += adjusted / line_range * min_inst_length;
+                line += line_base + (int64_t)(adjusted % line_range);
+                emit();
+                continue;
+            }
+            switch (opcode) {
+                case 0: {
+                    uint64_t size = unit.uleb();
+                    size_t end = unit.offset() + size;
+                    if (size == 0) {
+                        break;
+                    }
+                    uint64_t extended = unit.fixed(1);
+                    if (extended == DW_LNE_end_sequence) {
+                        sequence_start = rows_.size();
+                        addr = 0;
+                        file = 1;
+                        line = 1;
+                    }
+                    else if (extended == DW_LNE_set_address) {
+                        addr = unit.fixed(std::min<uint64_t>(size - 1, 8));
+                    }
+                    else if (extended == DW_LNE_define_file) {
+                        const char *name = unit.str();
+                        uint64_t dir = unit.uleb();
+                        unit_files.push_back(file_id(join_path(dir < dirs.size() ? dirs[dir] : "", name)));
+                    }
+                    unit.seek(end);
+                    break;
+                }
+                case DW_LNS_copy:
+                    emit();
+                    break;
+                case DW_LNS_advance_pc:
+                    addr += unit.uleb() * min_inst_length;
+                    break;
+                case DW_LNS_advance_line:
+                    line += unit.sleb();
+                    break;
+                case DW_LNS_set_file:
+                    file = unit.uleb();
+                    break;
+                case DW_LNS_const_add_pc:
+                    addr += (255 - opcode_base) / line_range * min_inst_length;
+                    break;
+                case DW_LNS_fixed_advance_pc:
+                    addr += unit.fixed(2);
+                    break;
+                default:
+                    // Column, flags, isa and unknown opcodes: only operands are skipped
+                    for (uint64_t i = 0; i < opcode_lengths[opcode - 1]; i++) {
+                        unit.uleb();
+                    }
+            }
+        }
+    }
+
+    std::stable_sort(rows_.begin(), rows_.end(), [](const Row& a, const Row& b) {
+        return a.addr < b.addr;
+    });
+}
+
+const std::vector<Line_table::Row>& Line_table::rows() const {
+    return rows_;
+}
+
+size_t Line_table::lower_bound(Elf32_Addr addr) const {
+    return std::lower_bound(rows_.begin(), rows_.end(), addr, [](const Row& row, Elf32_Addr addr) {
+        return row.addr < addr;
+    }) - rows_.begin();
+}
+
+const std::vector<std::string>& Line_table::files() const {
+    return files_;
+}
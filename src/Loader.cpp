@@ -0,0 +1,89 @@
+#include "Loader.h"
+
+const char* Loader::get_symbol_bind(char byte) {
+    switch (byte) {
+        case 0:
+            return "LOCAL";
+        case 1:
+            return "GLOBAL";
+        case 2:
+            return "WEAK";
+        case 10:
+            return "LOOS";
+        case 12:
+            return "HIOS";
+        case 13:
+            return "LOPROC";
+        case 15:
+            return "HIPROC";
+           default:
+            return "UNKNOWN";
+    }
+}
+
+std::string Loader::get_symbol_index(Elf32_Half ndx) {
+    switch (ndx) {
+        case 0:
+            return "UNDEF";
+        case 0xff00:
+            return "LOPROC";
+        case 0xff1f:
+            return "HIPROC";
+        case 0xff20:
+            return "LOOS";
+        case 0xff3f:
+            return "HIOS";
+        case 0xfff1:
+            return "ABS";
+        case 0xfff2:
+            return "COMMON";
+        case 0xffff:
+            return "XINDEX";
+        default:
+            return std::to_string(ndx);
+    }
+}
+
+const char* Loader::get_symbol_type(char byte) {
+    switch (byte) {
+        case 0:
+            return "NOTYPE";
+        case 1:
+            return "OBJECT";
+        case 2:
+            return "FUNC";
+        case 3:
+            return "SECTION";
+        case 4:
+            return "FILE";
+        case 5:
+            return "COMMON";
+        case 6:
+            return "TLS";
+        case 10:
+            return "LOOS";
+        case 12:
+            return "HIOS";
+        case 13:
+            return "LOPROC";
+        case 15:
+            return "HIPROC";
+           default:
+            return "UNKNOWN";
+    }
+}
+
+const char* Loader::get_symbol_visibility(char byte) {
+    switch (byte) {
+        case 0:
+            return "DEFAULT";
+        case 1:
+            return "INTERNAL";
+        case 2:
+            return "HIDDEN";
+        case 3:
+            return "PROTECTED";
+           default:
+            return "UNKNOWN";
+    }
+}
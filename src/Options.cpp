@@ -0,0 +1,209 @@
+#include "Options.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+// Value of the option at argv[i], which goes as the next argument
+static std::string option_value(int argc, char **argv, int& i) {
+    if (i + 1 >= argc) {
+        throw std::runtime_error(std::string("Missing value of ") + argv[i] + ".");
+    }
+    return argv[++i];
+}
+
+// Decimal, 0x-prefixed hex or 0-prefixed octal 32-bit address at argv[i + 1]
+static uint32_t address_value(int argc, char **argv, int& i) {
+    std::string option = argv[i];
+    std::string value = option_value(argc, argv, i);
+    char *end;
+    unsigned long long address = strtoull(value.c_str(), &end, 0);
+    if (value.empty() || *end != '\0' || address > UINT32_MAX) {
+        throw std::runtime_error("Invalid value of " + option + ": " + value + ".");
+    }
+    return address;
+}
+
+Options parse_options(int argc, char **argv) {
+    Options options;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--annotate") {
+            options.annotate_lines = true;
+        }
+        else if (arg == "--pseudo") {
+            options.pseudo_instructions = true;
+        }
+        else if (arg == "--profile") {
+            options.profile = option_value(argc, argv, i);
+        }
+        else if (arg == "--format") {
+            options.format = option_value(argc, argv, i);
+            if (options.format != "elf" && options.format != "bin" && options.format != "hex") {
+                throw std::runtime_error("Unknown format " + options.format + ".");
+            }
+        }
+        else if (arg == "--base-addr") {
+            options.base_addr = address_value(argc, argv, i);
+            options.has_base_addr = true;
+        }
+        else if (arg == "--function") {
+            options.functions.push_back(option_value(argc, argv, i));
+        }
+        else if (arg == "--start-address") {
+            options.start_address = address_value(argc, argv, i);
+        }
+        else if (arg == "--stop-address") {
+            options.stop_address = address_value(argc, argv, i);
+        }
+        else if (arg == "--map") {
+            options.map = option_value(argc, argv, i);
+        }
+        else if (arg == "--source") {
+            options.source_lines = true;
+        }
+        else if (arg == "--cycles") {
+            options.cycles = option_value(argc, argv, i);
+        }
+        else if (arg == "--dump-data") {
+            options.dump_data = true;
+        }
+        else if (arg == "--stats") {
+            options.stats = true;
+        }
+        else if (arg == "--registers") {
+            options.register_usage = true;
+        }
+        else if (arg == "--build-index") {
+            options.build_index = option_value(argc, argv, i);
+        }
+        else if (arg == "--query-index") {
+            options.query_index = option_value(argc, argv, i);
+        }
+        else if (arg == "--min-similarity") {
+            std::string value = option_value(argc, argv, i);
+            char *end;
+            options.min_similarity = strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !(options.min_similarity >= 0 && options.min_similarity <= 1)) {
+                throw std::runtime_error("Invalid value of --min-similarity: " + value + ".");
+            }
+        }
+        else if (arg == "--trace") {
+            options.trace = option_value(argc, argv, i);
+        }
+        else if (arg == "--top") {
+            std::string value = option_value(argc, argv, i);
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                throw std::runtime_error("Invalid value of --top: " + value + ".");
+            }
+            options.top_functions = std::stoul(value);
+        }
+        else if (arg.size() > 1 && arg[0] == '-' && arg != "-") {
+            throw std::runtime_error("Unknown option " + arg + ".");
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.size() < 2) {
+        throw std::runtime_error("Wrong number of arguments.");
+    }
+    if (options.has_base_addr && options.format.empty()) {
+        options.format = "bin";
+    }
+    if (options.has_base_addr && options.format != "bin") {
+        throw std::runtime_error("--base-addr is only for raw binaries.");
+    }
+    if (!options.map.empty() && options.format == "elf") {
+        throw std::runtime_error("--map is only for raw binary and HEX images.");
+    }
+    if (options.dump_data && (options.register_usage || !options.trace.empty())) {
+        throw std::runtime_error("--dump-data goes with the listing only.");
+    }
+    if (options.source_lines && (options.register_usage || !options.trace.empty())) {
+        throw std::runtime_error("--source goes with the listing only.");
+    }
+    if (!options.cycles.empty() && (options.register_usage || !options.trace.empty())) {
+        throw std::runtime_error("--cycles goes with the listing only.");
+    }
+    // A trace line is the command at its PC as is, only --annotate applies
+    if (!options.trace.empty() && (options.pseudo_instructions || options.register_usage || !options.profile.empty() ||
+                                   !options.functions.empty() || options.start_address != 0 ||
+                                   options.stop_address != UINT32_MAX)) {
+        throw std::runtime_error("--trace takes --annotate only.");
+    }
+    if (options.top_functions > 0 && options.profile.empty()) {
+        throw std::runtime_error("--top needs --profile.");
+    }
+    if (!options.build_index.empty() || !options.query_index.empty()) {
+        check_function_index(options);
+    }
+    options.inputs.assign(files.begin(), files.end() - 1);
+    options.output = files.back();
+    if (options.trace == "-" && std::find(options.inputs.begin(), options.inputs.end(), "-") != options.inputs.end()) {
+        throw std::runtime_error("Trace and input can't both be stdin.");
+    }
+    if (options.inputs.size() > 1) {
+        check_several_objects(options);
+        for (const std::string& input : options.inputs) {
+            if (input == "-") {
+                throw std::runtime_error("Stdin is only for a single input.");
+            }
+        }
+    }
+    return options;
+}
+
+void check_several_objects(const Options& options) {
+    if (!options.trace.empty() || options.register_usage || !options.profile.empty() || !options.functions.empty() ||
+        options.start_address != 0 || options.stop_address != UINT32_MAX) {
+        throw std::runtime_error("Several objects go with the whole listing only.");
+    }
+    if (options.format == "bin" || options.format == "hex") {
+        throw std::runtime_error("Several objects must be ELF.");
+    }
+}
+
+void check_function_index(const Options& options) {
+    if (!options.build_index.empty() && !options.query_index.empty()) {
+        throw std::runtime_error("--build-index and --query-index go separately.");
+    }
+    if (!options.trace.empty() || options.register_usage || !options.profile.empty() || options.source_lines ||
+        options.dump_data || !options.cycles.empty() || options.start_address != 0 || options.stop_address != UINT32_MAX) {
+        throw std::runtime_error("Function index goes with ELF functions only.");
+    }
+    if (!options.build_index.empty() && !options.functions.empty()) {
+        throw std::runtime_error("--build-index indexes all functions.");
+    }
+    if (options.format == "bin" || options.format == "hex") {
+        throw std::runtime_error("Function index needs ELF inputs.");
+    }
+}
+
+const char* usage() {
+    return "Usage: risc_disasm [options] <input_file>... <output_file>\n"
+           "  -                use stdin or stdout instead of a file\n"
+           "  <input_file>...  several ELF objects or .a archives are listed object by object\n"
+           "  --format F       input format: elf, bin or hex; ELF and HEX are detected by default\n"
+           "  --base-addr A    load address of a raw binary, implies --format bin\n"
+           "  --map FILE       symbols of a bin or hex image, \"<address> [<size>] [<type>] <name>\" lines\n"
+           "  --annotate       end every command with <func+0x<offset>>\n"
+           "  --pseudo         print pseudo-instructions and resolve lui/auipc addresses\n"
+           "  --profile FILE   prefix commands with their share of \"<hex address> [count]\" samples\n"
+           "  --top N          with --profile, print only N functions with the most samples\n"
+           "  --trace FILE     print a line per PC of a raw little-endian 32-bit PC trace\n"
+           "  --function NAME  print only this function, may be repeated\n"
+           "  --start-address A  print only commands at or after address A\n"
+           "  --stop-address A   print only commands before address A\n"
+           "  --source         print source lines of .debug_line before their commands\n"
+           "  --cycles FILE    annotate blocks and functions with cycle estimates of a \"<class> <cycles>\" model\n"
+           "  --dump-data      hex and ASCII dump of data sections after the listing\n"
+           "  --stats          print render cache hit rate to stderr\n"
+           "  --registers      print registers read, written, clobbered and saved by every function\n"
+           "  --build-index FILE  write MinHash fingerprints of all functions of the inputs to FILE\n"
+           "  --query-index FILE  print functions of FILE similar to functions of the inputs\n"
+           "  --min-similarity S  with --query-index, lowest estimated similarity to print, 0.5 by default\n";
+}
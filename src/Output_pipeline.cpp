@@ -0,0 +1,329 @@
+#include "Output_pipeline.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define OUTPUT_PIPELINE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Minimal io_uring submission of positioned writes through raw syscalls.
+// available is false if the kernel (or a sandbox) does not provide io_uring.
+struct Output_pipeline::Uring {
+    bool available = false;
+
+#ifdef OUTPUT_PIPELINE_IO_URING
+    int ring_fd = -1;
+    void *sq_ptr = MAP_FAILED;
+    void *cq_ptr = MAP_FAILED;
+    size_t sq_size = 0;
+    size_t cq_size = 0;
+    io_uring_sqe *sqes = (io_uring_sqe*)MAP_FAILED;
+    size_t sqes_size = 0;
+    unsigned entries = 0;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+
+    Uring(unsigned queue_depth) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring_fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+        if (ring_fd < 0) {
+            return;
+        }
+        entries = params.sq_entries;
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+
+        sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            return;
+        }
+        cq_ptr = single_mmap ? sq_ptr :
+                 mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            return;
+        }
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return;
+        }
+
+        char *sq = (char*)sq_ptr;
+        char *cq = (char*)cq_ptr;
+        sq_tail  = (unsigned*)(sq + params.sq_off.tail);
+        sq_mask  = (unsigned*)(sq + params.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq + params.sq_off.array);
+        cq_head  = (unsigned*)(cq + params.cq_off.head);
+        cq_tail  = (unsigned*)(cq + params.cq_off.tail);
+        cq_mask  = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes     = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        available = true;
+    }
+
+    ~Uring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+            munmap(cq_ptr, cq_size);
+        }
+        if (sq_ptr != MAP_FAILED) {
+            munmap(sq_ptr, sq_size);
+        }
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+    }
+
+    // Writes batch to fd starting at offset, returns 0 or errno
+    int write(int fd, long long offset, const std::vector<std::string*>& batch) {
+        size_t done = 0;
+        while (done < batch.size()) {
+            size_t count = std::min<size_t>(entries, batch.size() - done);
+            int error = write_some(fd, offset, batch.data() + done, count);
+            if (error != 0) {
+                return error;
+            }
+            for (size_t i = 0; i < count; i++) {
+                offset += batch[done + i]->size();
+            }
+            done += count;
+        }
+        return 0;
+    }
+
+    int write_some(int fd, long long offset, std::string *const *batch, size_t count) {
+        unsigned tail = __atomic_load_n(sq_tail, __ATOMIC_ACQUIRE);
+        long long position = offset;
+        std::vector<long long> positions(count);
+        for (size_t i = 0; i < count; i++) {
+            unsigned idx = (tail + i) & *sq_mask;
+            io_uring_sqe *sqe = &sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = fd;
+            sqe->addr = (unsigned long long)batch[i]->data();
+            sqe->len = batch[i]->size();
+            sqe->off = position;
+            sqe->user_data = i;
+            sq_array[idx] = idx;
+            positions[i] = position;
+            position += batch[i]->size();
+        }
+        __atomic_store_n(sq_tail, tail + count, __ATOMIC_RELEASE);
+
+        int error = 0;
+        size_t submitted = 0;
+        size_t completed = 0;
+        while (completed < count) {
+            unsigned to_submit = count - submitted;
+            int ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                return errno;
+            }
+            submitted += ret;
+
+            unsigned head = __atomic_load_n(cq_head, __ATOMIC_RELAXED);
+            while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                io_uring_cqe *cqe = &cqes[head & *cq_mask];
+                size_t i = cqe->user_data;
+                int res = cqe->res;
+                head++;
+                completed++;
+                __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+                // Short writes and kernels without IORING_OP_WRITE finish synchronously
+                size_t written = res > 0 ? res : 0;
+                if (res < 0 && res != -EINVAL && res != -EOPNOTSUPP) {
+                    error = -res;
+                    continue;
+                }
+                if (res < 0) {
+                    available = false;
+                }
+                while (written < batch[i]->size() && error == 0) {
+                    ssize_t ret_write = pwrite(fd, batch[i]->data() + written, batch[i]->size() - written, positions[i] + written);
+                    if (ret_write < 0 && errno != EINTR) {
+                        error = errno;
+                    }
+                    else if (ret_write > 0) {
+                        written += ret_write;
+                    }
+                }
+            }
+        }
+        return error;
+    }
+#else
+    Uring(unsigned) {}
+
+    int write(int, long long, const std::vector<std::string*>&) {
+        return ENOSYS;
+    }
+#endif
+};
+
+Output_pipeline::Output_pipeline(int fd, size_t buffer_count, size_t buffer_size)
+    : fd_(fd), offset_(-1), buffers_(buffer_count), next_seq_(0), finishing_(false), error_(0) {
+    for (std::string& buffer : buffers_) {
+        buffer.reserve(buffer_size);
+        free_.push_back(&buffer);
+    }
+
+    // Positioned writes keep order only in a seekable file without O_APPEND
+    int flags = fcntl(fd_, F_GETFL);
+    off_t position = lseek(fd_, 0, SEEK_CUR);
+    if (flags >= 0 && !(flags & O_APPEND) && position >= 0) {
+        offset_ = position;
+        uring_.reset(new Uring(buffer_count));
+    }
+    writer_ = std::thread(&Output_pipeline::write_loop, this);
+}
+
+Output_pipeline::~Output_pipeline() {
+    if (writer_.joinable()) {
+        try {
+            finish();
+        } catch (std::exception&) {
+        }
+    }
+}
+
+std::string* Output_pipeline::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    buffer_freed_.wait(lock, [this]() { return !free_.empty(); });
+    std::string *buffer = free_.back();
+    free_.pop_back();
+    return buffer;
+}
+
+void Output_pipeline::release(std::string* buffer) {
+    buffer->clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(buffer);
+    buffer_freed_.notify_one();
+}
+
+void Output_pipeline::submit(size_t seq, std::string* buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_[seq] = buffer;
+    if (seq == next_seq_) {
+        buffer_ready_.notify_one();
+    }
+}
+
+void Output_pipeline::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+        buffer_ready_.notify_one();
+    }
+    writer_.join();
+
+    if (uring_ && offset_ >= 0) {
+        lseek(fd_, offset_, SEEK_SET);
+    }
+    if (error_ != 0) {
+        throw std::runtime_error(std::string("Write error: ") + strerror(error_));
+    }
+}
+
+void Output_pipeline::write_loop() {
+    std::vector<std::string*> batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            buffer_ready_.wait(lock, [this]() {
+                return (!ready_.empty() && ready_.begin()->first == next_seq_) || finishing_;
+            });
+            // Everything ready in sequence goes in one batch
+            while (!ready_.empty() && ready_.begin()->first == next_seq_) {
+                batch.push_back(ready_.begin()->second);
+                ready_.erase(ready_.begin());
+                next_seq_++;
+            }
+            if (batch.empty() && finishing_) {
+                return;
+            }
+        }
+
+        // After an error the rest of output is dropped, buffers still go back
+        if (error_ == 0) {
+            error_ = write_buffers(batch);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::string *buffer : batch) {
+            buffer->clear();
+            free_.push_back(buffer);
+        }
+        batch.clear();
+        buffer_freed_.notify_all();
+    }
+}
+
+int Output_pipeline::write_buffers(const std::vector<std::string*>& batch) {
+    if (uring_ && uring_->available) {
+        int error = uring_->write(fd_, offset_, batch);
+        for (std::string *buffer : batch) {
+            offset_ += buffer->size();
+        }
+        return error;
+    }
+    if (uring_) {
+        // io_uring turned out to be unusable after some positioned writes
+        lseek(fd_, offset_, SEEK_SET);
+        uring_.reset();
+    }
+    return write_all(batch);
+}
+
+// Portable path: writev of the whole batch, repeated after short writes
+int Output_pipeline::write_all(const std::vector<std::string*>& batch) {
+    std::vector<iovec> iov;
+    for (std::string *buffer : batch) {
+        if (!buffer->empty()) {
+            iov.push_back({(void*)buffer->data(), buffer->size()});
+        }
+    }
+
+    size_t first = 0;
+    while (first < iov.size()) {
+        int count = std::min<size_t>(iov.size() - first, IOV_MAX);
+        ssize_t written = writev(fd_, iov.data() + first, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        while (first < iov.size() && (size_t)written >= iov[first].iov_len) {
+            written -= iov[first].iov_len;
+            first++;
+        }
+        if (first < iov.size()) {
+            iov[first].iov_base = (char*)iov[first].iov_base + written;
+            iov[first].iov_len -= written;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "Peephole.h"
+#include <cstring>
+
+namespace {
+
+constexpr const Isa_cmd *isa_lui = isa_find("lui");
+constexpr const Isa_cmd *isa_auipc = isa_find("auipc");
+constexpr const Isa_cmd *isa_jal = isa_find("jal");
+constexpr const Isa_cmd *isa_jalr = isa_find("jalr");
+constexpr const Isa_cmd *isa_addi = isa_find("addi");
+
+const Elf32_Word reg_zero = 0;
+const Elf32_Word reg_ra = 1;
+
+Elf32_Word read_rd(Elf32_Word cmd) {
+    return (cmd >> 7) & 0x1f;
+}
+
+Elf32_Word read_rs1(Elf32_Word cmd) {
+    return (cmd >> 15) & 0x1f;
+}
+
+}
+
+Peephole::Peephole() {
+    reset();
+}
+
+void Peephole::reset() {
+    for (Hi_value& reg : regs_) {
+        reg = {0, 0};
+    }
+    count_ = 0;
+    fused_ = false;
+}
+
+Pseudo Peephole::step(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr,
+                      Elf32_Word next, const Isa_cmd *next_isa_cmd) {
+    Pseudo pseudo = {Pseudo_kind::none, 0, 0, 0, false, 0};
+    count_++;
+    if (isa_cmd == nullptr) {
+        return pseudo;
+    }
+
+    if (fused_) {
+        fused_ = false;
+        pseudo.kind = Pseudo_kind::fused;
+    }
+    else if (match_pair(cmd, isa_cmd, addr, next, next_isa_cmd, pseudo)) {
+        fused_ = true;
+    }
+    else {
+        match_single(cmd, isa_cmd, addr, pseudo);
+        resolve(cmd, isa_cmd, pseudo);
+    }
+
+    // Remember upper parts, forget registers overwritten by anything else
+    Elf32_Word rd = read_rd(cmd);
+    if ((isa_cmd == isa_lui || isa_cmd == isa_auipc) && rd != reg_zero) {
+        Elf32_Word base = isa_cmd == isa_auipc ? addr : 0;
+        regs_[rd] = {base + (isa_imm_u(cmd) << 12), count_ + window};
+    }
+    else if (isa_cmd->operands[0] == 'd') {
+        regs_[rd].until = 0;
+    }
+    return pseudo;
+}
+
+// auipc + addi/jalr and lui + addi on the same register
+bool Peephole::match_pair(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr,
+                          Elf32_Word next, const Isa_cmd *next_isa_cmd, Pseudo& pseudo) const {
+    if (isa_cmd != isa_lui && isa_cmd != isa_auipc) {
+        return false;
+    }
+    Elf32_Word rd = read_rd(cmd);
+    if (next_isa_cmd == nullptr || rd == reg_zero || read_rs1(next) != rd) {
+        return false;
+    }
+
+    Elf32_Word value = (isa_cmd == isa_auipc ? addr : 0) + (isa_imm_u(cmd) << 12) + isa_imm_i(next);
+    Elf32_Word next_rd = read_rd(next);
+    if (next_isa_cmd == isa_addi && next_rd == rd) {
+        pseudo.kind = isa_cmd == isa_auipc ? Pseudo_kind::la : Pseudo_kind::li;
+        // lui pair builds a plain number which often is an address
+        pseudo.resolved = isa_cmd == isa_lui;
+        pseudo.address = value;
+    }
+    else if (next_isa_cmd == isa_jalr && isa_cmd == isa_auipc && next_rd == reg_ra) {
+        pseudo.kind = Pseudo_kind::call;
+    }
+    else if (next_isa_cmd == isa_jalr && isa_cmd == isa_auipc && next_rd == reg_zero) {
+        pseudo.kind = Pseudo_kind::tail;
+    }
+    else {
+        return false;
+    }
+    pseudo.rd = rd;
+    pseudo.value = value;
+    return true;
+}
+
+void Peephole::match_single(Elf32_Word cmd, const Isa_cmd *isa_cmd, Elf32_Addr addr, Pseudo& pseudo) const {
+    Elf32_Word rd = read_rd(cmd);
+    Elf32_Word rs = read_rs1(cmd);
+
+    if (isa_cmd == isa_addi) {
+        Elf32_Word imm = isa_imm_i(cmd);
+        if (rd == reg_zero && rs == reg_zero && imm == 0) {
+            pseudo.kind = Pseudo_kind::nop;
+        }
+        else if (rs == reg_zero) {
+            pseudo.kind = Pseudo_kind::li;
+            pseudo.value = imm;
+        }
+        else if (imm == 0) {
+            pseudo.kind = Pseudo_kind::mv;
+        }
+    }
+    else if (isa_cmd == isa_jalr && rd == reg_zero && rs == reg_ra && isa_imm_i(cmd) == 0) {
+        pseudo.kind = Pseudo_kind::ret;
+    }
+    else if (isa_cmd == isa_jal && rd == reg_zero) {
+        pseudo.kind = Pseudo_kind::j;
+        pseudo.value = addr + isa_imm_j(cmd);
+    }
+    pseudo.rd = rd;
+    pseudo.rs = rs;
+}
+
+// Address of addi, jalr, load, store or atomic based on a remembered register
+void Peephole::resolve(Elf32_Word cmd, const Isa_cmd *isa_cmd, Pseudo& pseudo) const {
+    const char *base = strstr(isa_cmd->operands, "(s)");
+    if (isa_cmd != isa_addi && base == nullptr) {
+        return;
+    }
+    const Hi_value& hi = regs_[read_rs1(cmd)];
+    if (read_rs1(cmd) == reg_zero || count_ > hi.until) {
+        return;
+    }
+
+    Elf32_Word offset = 0;
+    if (isa_cmd == isa_addi || (base != isa_cmd->operands && base[-1] == 'j')) {
+        offset = isa_imm_i(cmd);
+    }
+    else if (base != isa_cmd->operands && base[-1] == 'q') {
+        offset = isa_imm_s(cmd);
+    }
+    pseudo.resolved = true;
+    pseudo.address = hi.value + offset;
+}
@@ -0,0 +1,185 @@
+#include "Profile.h"
+#include "Input_source.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ':' || c == ',';
+}
+
+// Start of the next line
+const char* skip_line(const char *data, const char *end) {
+    while (data < end && *data != '\n') {
+        data++;
+    }
+    return data < end ? data + 1 : end;
+}
+
+}
+
+Profile::Profile() : total_(0) {}
+
+void Profile::load(const std::string& path) {
+    int fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Invalid profile file.");
+    }
+    try {
+        Input_source source(fd);
+        size_t size;
+        const char *data = source.read_all(size);
+        parse(data, size);
+    } catch (std::exception&) {
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+        throw;
+    }
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    sort_samples();
+}
+
+// Single pass over the file, no allocation per line
+void Profile::parse(const char *data, size_t size) {
+    const char *end = data + size;
+    size_t line = 0;
+
+    while (data < end) {
+        line++;
+        while (data < end && is_blank(*data)) {
+            data++;
+        }
+        if (data == end || *data == '\n' || *data == '#') {
+            data = skip_line(data, end);
+            continue;
+        }
+
+        if (end - data > 2 && data[0] == '0' && (data[1] == 'x' || data[1] == 'X')) {
+            data += 2;
+        }
+        Elf32_Addr addr = 0;
+        int digits = 0;
+        for (int digit; data < end && (digit = hex_digit(*data)) >= 0; data++) {
+            addr = addr << 4 | digit;
+            digits++;
+        }
+        while (data < end && is_blank(*data)) {
+            data++;
+        }
+        uint64_t count = 0;
+        bool has_count = false;
+        bool overflow = false;
+        for (; data < end && *data >= '0' && *data <= '9'; data++) {
+            overflow |= count > (UINT64_MAX - (*data - '0')) / 10;
+            count = count * 10 + (*data - '0');
+            has_count = true;
+        }
+        while (data < end && is_blank(*data)) {
+            data++;
+        }
+
+        if (digits == 0 || digits > 8 || (data < end && *data != '\n' && *data != '#')) {
+            throw std::runtime_error("Invalid profile line " + std::to_string(line) + ".");
+        }
+        data = skip_line(data, end);
+
+        if (!has_count) {
+            count = 1;
+        }
+        // Merged and cumulative counts are parts of the total, so they can't
+        // overflow either
+        if (overflow || count > UINT64_MAX - total_) {
+            throw std::runtime_error("Sample count overflow in profile line " + std::to_string(line) + ".");
+        }
+        samples_.push_back({addr, count});
+        total_ += count;
+    }
+}
+
+// LSD radix sort by address, then samples of equal addresses are merged
+void Profile::sort_samples() {
+    if (samples_.empty()) {
+        return;
+    }
+    std::vector<Sample> sorted(samples_.size());
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t offsets[257] = {};
+        for (const Sample& sample : samples_) {
+            offsets[((sample.addr >> shift) & 0xff) + 1]++;
+        }
+        // All samples share this byte, e.g. high bytes of a small .text
+        if (offsets[((samples_[0].addr >> shift) & 0xff) + 1] == samples_.size()) {
+            continue;
+        }
+        for (int i = 0; i < 256; i++) {
+            offsets[i + 1] += offsets[i];
+        }
+        for (const Sample& sample : samples_) {
+            sorted[offsets[(sample.addr >> shift) & 0xff]++] = sample;
+        }
+        samples_.swap(sorted);
+    }
+
+    size_t merged = 0;
+    for (size_t i = 0; i < samples_.size(); i++) {
+        if (merged > 0 && samples_[merged - 1].addr == samples_[i].addr) {
+            samples_[merged - 1].count += samples_[i].count;
+        }
+        else {
+            samples_[merged++] = samples_[i];
+        }
+    }
+    samples_.resize(merged);
+}
+
+// Merge join of sorted samples with the commands, which are sorted by address too
+void Profile::join(Elf32_Addr text_start, size_t cmds_count) {
+    cumulative_.assign(cmds_count + 1, 0);
+    size_t sample = 0;
+    while (sample < samples_.size() && samples_[sample].addr < text_start) {
+        sample++;
+    }
+    for (size_t i = 0; i < cmds_count; i++) {
+        Elf32_Addr cmd_end = text_start + (i + 1) * sizeof(Elf32_Word);
+        uint64_t count = 0;
+        for (; sample < samples_.size() && samples_[sample].addr < cmd_end; sample++) {
+            count += samples_[sample].count;
+        }
+        cumulative_[i + 1] = cumulative_[i] + count;
+    }
+}
+
+uint64_t Profile::total() const {
+    return total_;
+}
+
+uint64_t Profile::count(size_t first, size_t last) const {
+    if (cumulative_.empty()) {
+        return 0;
+    }
+    if (last >= cumulative_.size()) {
+        last = cumulative_.size() - 1;
+    }
+    if (first >= last) {
+        return 0;
+    }
+    return cumulative_[last] - cumulative_[first];
+}
@@ -0,0 +1,45 @@
+#include "Render_cache.h"
+#include <cstring>
+
+static_assert(sizeof(Elf32_Word) + 1 + Render_cache::max_text_size == 64, "Render_cache entry fills one cache line");
+
+Render_cache::Render_cache() : lookups_(0), hits_(0) {
+    for (Entry& entry : entries_) {
+        entry.size = 0;
+    }
+}
+
+// Fibonacci hashing: similar words, e.g. differing in rd only, spread apart
+size_t Render_cache::slot(Elf32_Word word) const {
+    return (Elf32_Word)(word * 0x9e3779b1u) >> (32 - 12);
+}
+static_assert(Render_cache::slots == 1 << 12, "slot() takes 12 bits of hash");
+
+bool Render_cache::append(Elf32_Word word, std::string& out) {
+    lookups_++;
+    const Entry& entry = entries_[slot(word)];
+    if (entry.size == 0 || entry.word != word) {
+        return false;
+    }
+    hits_++;
+    out.append(entry.text, entry.size);
+    return true;
+}
+
+void Render_cache::insert(Elf32_Word word, const char *text, size_t size) {
+    if (size == 0 || size > max_text_size) {
+        return;
+    }
+    Entry& entry = entries_[slot(word)];
+    entry.word = word;
+    entry.size = size;
+    memcpy(entry.text, text, size);
+}
+
+uint64_t Render_cache::lookups() const {
+    return lookups_;
+}
+
+uint64_t Render_cache::hits() const {
+    return hits_;
+}
@@ -0,0 +1,95 @@
+#include "Section_table.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Section counts and the names index which do not fit the ELF header are in
+// section 0: sh_size and sh_link
+#define SHN_LORESERVE  0xff00
+#define SHN_XINDEX     0xffff
+
+Section_table::Section_table() : contents_end_(0) {}
+
+void Section_table::load(Input_source& source, size_t base, const Elf32_Ehdr& header) {
+    headers_.clear();
+    names_.clear();
+    by_name_.clear();
+    by_type_.clear();
+    contents_end_ = 0;
+    if (header.e_shoff == 0) {
+        // Only the null section, so lookups of missing sections still work
+        headers_.resize(1);
+        names_.assign(1, '\0');
+        return;
+    }
+    if (header.e_shentsize != sizeof(Elf32_Shdr)) {
+        throw std::runtime_error("Invalid section header size.");
+    }
+
+    Elf32_Shdr first;
+    memcpy(&first, source.read(base + header.e_shoff, sizeof(Elf32_Shdr)), sizeof(Elf32_Shdr));
+    size_t count = header.e_shnum != 0 ? header.e_shnum : first.sh_size;
+    size_t names_idx = header.e_shstrndx != SHN_XINDEX ? header.e_shstrndx : first.sh_link;
+    if (count == 0 || names_idx >= count) {
+        throw std::runtime_error("Invalid section names index.");
+    }
+
+    // Whole table at once
+    headers_.resize(count);
+    memcpy(headers_.data(), source.read(base + header.e_shoff, count * sizeof(Elf32_Shdr)), count * sizeof(Elf32_Shdr));
+    for (const Elf32_Shdr& hdr : headers_) {
+        if (hdr.sh_type != SHT_NOBITS && hdr.sh_type != SHT_NULL) {
+            contents_end_ = std::max<size_t>(contents_end_, (size_t)hdr.sh_offset + hdr.sh_size);
+        }
+    }
+    // One read validates all contents and brings a pipe input up to the last
+    // section, so it is never read again
+    source.read(base, contents_end_);
+
+    const Elf32_Shdr& names = headers_[names_idx];
+    names_.assign(source.read(base + names.sh_offset, names.sh_size), names.sh_size);
+    by_name_.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        const Elf32_Shdr& hdr = headers_[i];
+        if (hdr.sh_name >= names_.size() && !(i == 0 && hdr.sh_name == 0)) {
+            throw std::runtime_error("Invalid name of section " + std::to_string(i) + ".");
+        }
+        if ((hdr.sh_type == SHT_SYMTAB || hdr.sh_type == SHT_DYNSYM || hdr.sh_type == SHT_RELA || hdr.sh_type == SHT_REL) &&
+            hdr.sh_link >= count) {
+            throw std::runtime_error("Invalid link of section " + std::to_string(i) + ".");
+        }
+        // Keeps the first section of a name
+        by_name_.emplace(get_name(i), i);
+        by_type_[hdr.sh_type].push_back(i);
+    }
+}
+
+size_t Section_table::size() const {
+    return headers_.size();
+}
+
+const Elf32_Shdr& Section_table::get(size_t idx) const {
+    return headers_[idx];
+}
+
+const char* Section_table::get_name(size_t idx) const {
+    if (headers_[idx].sh_name >= names_.size()) {
+        return "";
+    }
+    return names_.c_str() + headers_[idx].sh_name;
+}
+
+size_t Section_table::find(const char *name) const {
+    auto section = by_name_.find(name);
+    return section == by_name_.end() ? 0 : section->second;
+}
+
+const std::vector<size_t>& Section_table::find_type(Elf32_Word type) const {
+    static const std::vector<size_t> none;
+    auto sections = by_type_.find(type);
+    return sections == by_type_.end() ? none : sections->second;
+}
+
+size_t Section_table::contents_end() const {
+    return contents_end_;
+}
@@ -0,0 +1,54 @@
+#include "Source_pool.h"
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+
+Source_pool::Source_pool(const std::vector<std::string>& paths) : paths_(paths), files_(paths.size()) {}
+
+// A file which cannot be read stays without lines
+void Source_pool::open_file(uint32_t file) {
+    File& entry = files_[file];
+    int fd = open(paths_[file].c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    try {
+        entry.source.reset(new Input_source(fd));
+        entry.data = entry.source->read_all(entry.size);
+    } catch (std::exception&) {
+        entry.source.reset();
+        entry.data = nullptr;
+        entry.size = 0;
+    }
+    close(fd);
+    if (entry.data == nullptr) {
+        return;
+    }
+
+    for (size_t pos = 0; pos < entry.size;) {
+        entry.line_starts.push_back(pos);
+        const char *end = (const char*)memchr(entry.data + pos, '\n', entry.size - pos);
+        pos = end == nullptr ? entry.size : end - entry.data + 1;
+    }
+}
+
+bool Source_pool::get_line(uint32_t file, uint32_t line, const char*& text, size_t& size) {
+    if (file >= files_.size()) {
+        return false;
+    }
+    File& entry = files_[file];
+    std::call_once(entry.opened, &Source_pool::open_file, this, file);
+    if (line == 0 || line > entry.line_starts.size()) {
+        return false;
+    }
+
+    size_t start = entry.line_starts[line - 1];
+    size_t end = line < entry.line_starts.size() ? entry.line_starts[line] : entry.size;
+    while (end > start && (entry.data[end - 1] == '\n' || entry.data[end - 1] == '\r')) {
+        end--;
+    }
+    text = entry.data + start;
+    size = end - start;
+    return true;
+}
@@ -0,0 +1,60 @@
+#include "Symbol_index.h"
+#include "Loader.h"
+#include <algorithm>
+#include <cstdio>
+
+void Symbol_index::add(Elf32_Addr start, Elf32_Word size, const char *name, unsigned char type) {
+    if (size == 0 || name[0] == '\0') {
+        return;
+    }
+    symbols_.push_back({start, size, name, type});
+}
+
+void Symbol_index::build() {
+    std::stable_sort(symbols_.begin(), symbols_.end(), [](const Symbol& a, const Symbol& b) {
+        if (a.start != b.start) {
+            return a.start < b.start;
+        }
+        return a.type == STT_FUNC && b.type != STT_FUNC;
+    });
+    symbols_.erase(std::unique(symbols_.begin(), symbols_.end(), [](const Symbol& a, const Symbol& b) {
+        return a.start == b.start;
+    }), symbols_.end());
+}
+
+bool Symbol_index::empty() const {
+    return symbols_.empty();
+}
+
+const Symbol_index::Symbol* Symbol_index::find(Elf32_Addr addr) const {
+    // Last symbol starting at or before addr
+    auto it = std::upper_bound(symbols_.begin(), symbols_.end(), addr, [](Elf32_Addr value, const Symbol& symbol) {
+        return value < symbol.start;
+    });
+    if (it == symbols_.begin()) {
+        return nullptr;
+    }
+    --it;
+    if (addr - it->start >= it->size) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+bool Symbol_index::append_location(Elf32_Addr addr, std::string& out) const {
+    const Symbol *symbol = find(addr);
+    if (symbol == nullptr) {
+        return false;
+    }
+    out += symbol->name;
+    if (addr != symbol->start) {
+        char offset[16];
+        sprintf(offset, "+0x%x", addr - symbol->start);
+        out += offset;
+    }
+    return true;
+}
+
+const std::vector<Symbol_index::Symbol>& Symbol_index::symbols() const {
+    return symbols_;
+}
@@ -0,0 +1,26 @@
+#include "Trace_cache.h"
+#include <cstdio>
+
+Trace_cache::Trace_cache(const Cmd_parser& parser, size_t slots)
+    : parser_(parser), slots_(slots), mask_(slots - 1) {
+    for (Slot& slot : slots_) {
+        slot.pc = 0;
+        slot.valid = false;
+    }
+}
+
+void Trace_cache::append_line(Elf32_Addr pc, std::string& out) {
+    // Commands are word aligned, so the low bits of pc carry no index
+    Slot& slot = slots_[(pc >> 2) & mask_];
+    if (!slot.valid || slot.pc != pc) {
+        slot.line.clear();
+        if (!parser_.render_trace_line(pc, slot.line)) {
+            char fmt_string[64];
+            sprintf(fmt_string, "   %05x:\t\t# outside .text\n", pc);
+            slot.line = fmt_string;
+        }
+        slot.pc = pc;
+        slot.valid = true;
+    }
+    out += slot.line;
+}
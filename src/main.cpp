@@ -1,65 +1,770 @@
+#include "Archive.h"
+#include "Data_dump.h"
 #include "Elf_parser.h"
+#include "Function_index.h"
+#include "Image_loader.h"
 #include "Cmd_parser.h"
+#include "Output_pipeline.h"
+#include "Options.h"
+#include "Profile.h"
+#include "Trace_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
 using namespace std;
 
-void write_cmds(FILE *output, Elf_parser& elf_src) {
-    fprintf(output, ".text\n");
-    std::vector<std::string> cmds = Cmd_parser(elf_src).parse_cmds();
-    for (size_t i = 0; i < cmds.size(); i++) {
-        fprintf(output, "%s\n", cmds[i].c_str());
+// Commands rendered into one output buffer
+const size_t cmds_per_chunk = 8192;
+const size_t output_buffer_size = 1 << 20;
+// PCs read from a trace at once and rendered into one output buffer
+const size_t trace_block_pcs = 1 << 16;
+const size_t trace_cache_slots = 1 << 14;
+// Functions of register usage report rendered into one output buffer
+const size_t functions_per_chunk = 1024;
+// Matches of one function printed by --query-index
+const size_t max_similar_functions = 16;
+
+unsigned render_threads() {
+    unsigned threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+// Renders jobs [0, count) on all cores, output of job i gets sequence number seq + i.
+// The first error of a job stops the rest and is rethrown once all threads end;
+// every job taken is still submitted, so the output has no hole to wait for.
+template <typename Render>
+void render_jobs(Output_pipeline& output, size_t& seq, size_t count, Render render_job) {
+    size_t first_seq = seq;
+    std::atomic<size_t> next_job(0);
+    std::atomic<bool> failed(false);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    auto render = [&]() {
+        while (true) {
+            // Buffer goes first, so the lowest pending job always has one
+            std::string *buffer = output.acquire();
+            size_t job = failed ? count : next_job++;
+            if (job >= count) {
+                output.release(buffer);
+                return;
+            }
+            try {
+                render_job(job, *buffer);
+            } catch (...) {
+                buffer->clear();
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+            output.submit(first_seq + job, buffer);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < render_threads(); i++) {
+        workers.emplace_back(render);
+    }
+    render();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    seq += count;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void print_cache_stats(uint64_t lookups, uint64_t hits) {
+    char fmt_string[128];
+    sprintf(fmt_string, "render cache: %llu lookups, %llu hits (%.1f%%)\n", (unsigned long long)lookups,
+            (unsigned long long)hits, lookups == 0 ? 0.0 : 100.0 * hits / lookups);
+    std::cerr << fmt_string;
+}
+
+// Command ranges to render: whole .text, the named functions or the hottest
+// ones, cut to [--start-address, --stop-address)
+std::vector<std::pair<size_t, size_t>> select_ranges(const Cmd_parser& parser, const Options& options) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (options.top_functions > 0) {
+        ranges = parser.hottest_functions(options.top_functions);
+    }
+    else if (!options.functions.empty()) {
+        std::vector<Cmd_parser::Function_range> functions = parser.functions();
+        for (const std::string& name : options.functions) {
+            auto function = std::find_if(functions.begin(), functions.end(), [&](const Cmd_parser::Function_range& range) {
+                return range.name == name;
+            });
+            if (function == functions.end()) {
+                throw std::runtime_error("Unknown function " + name + ".");
+            }
+            ranges.push_back(std::make_pair(function->first, function->last));
+        }
+    }
+    else {
+        ranges.push_back(std::make_pair(0, parser.cmds_count()));
+    }
+
+    size_t first = parser.cmd_index(options.start_address);
+    size_t last = parser.cmd_index(options.stop_address);
+    std::vector<std::pair<size_t, size_t>> cut;
+    for (const auto& range : ranges) {
+        if (std::max(range.first, first) < std::min(range.second, last)) {
+            cut.push_back(std::make_pair(std::max(range.first, first), std::min(range.second, last)));
+        }
+    }
+    return cut;
+}
+
+// Renders .text in chunks on all cores, seq is the next output sequence number
+void write_cmds(Output_pipeline& output, size_t& seq, Loader& elf_src, const Options& options) {
+    Cmd_parser parser(elf_src);
+    parser.annotate_lines(options.annotate_lines);
+    parser.pseudo_instructions(options.pseudo_instructions);
+
+    Profile profile;
+    if (!options.profile.empty()) {
+        profile.load(options.profile);
+        profile.join(elf_src.get_text_start_addr(), parser.cmds_count());
+        parser.set_profile(&profile);
+    }
+
+    Cycle_model cycle_model;
+    if (!options.cycles.empty()) {
+        cycle_model.load(options.cycles);
+        parser.set_cycle_model(&cycle_model);
+    }
+
+    std::unique_ptr<Line_table> lines;
+    std::unique_ptr<Source_pool> sources;
+    if (options.source_lines) {
+        lines.reset(new Line_table(elf_src));
+        sources.reset(new Source_pool(lines->files()));
+        parser.set_source_lines(lines.get(), sources.get());
+    }
+
+    std::vector<std::pair<size_t, size_t>> ranges = select_ranges(parser, options);
+    parser.collect_labels(ranges);
+
+    std::string *header = output.acquire();
+    *header += ".text\n";
+    output.submit(seq++, header);
+
+    std::vector<std::pair<size_t, size_t>> chunks;
+    for (const auto& range : ranges) {
+        for (size_t first = range.first; first < range.second; first += cmds_per_chunk) {
+            chunks.push_back(std::make_pair(first, std::min(first + cmds_per_chunk, range.second)));
+        }
+    }
+
+    render_jobs(output, seq, chunks.size(), [&](size_t chunk, std::string& buffer) {
+        parser.render_lines(chunks[chunk].first, chunks[chunk].second, buffer);
+    });
+    if (options.stats) {
+        print_cache_stats(parser.render_cache_lookups(), parser.render_cache_hits());
+    }
+}
+
+// Register sets of every function, functions are rendered on all cores
+void write_register_usage(Output_pipeline& output, size_t& seq, Loader& elf_src) {
+    Cmd_parser parser(elf_src);
+    parser.collect_labels();
+    std::vector<Cmd_parser::Function_range> functions = parser.functions();
+
+    std::string *header = output.acquire();
+    *header += ".registers\n";
+    output.submit(seq++, header);
+
+    size_t chunks = (functions.size() + functions_per_chunk - 1) / functions_per_chunk;
+    render_jobs(output, seq, chunks, [&](size_t chunk, std::string& buffer) {
+        size_t last = std::min((chunk + 1) * functions_per_chunk, functions.size());
+        for (size_t i = chunk * functions_per_chunk; i < last; i++) {
+            parser.render_register_usage(functions[i], buffer);
+        }
+    });
+}
+
+// Hex and ASCII dump of data sections, chunks are rendered on all cores
+void write_data_sections(Output_pipeline& output, size_t& seq, Loader& elf_src) {
+    Data_dump dump(elf_src);
+    render_jobs(output, seq, dump.chunks_count(), [&](size_t chunk, std::string& buffer) {
+        dump.render_chunk(chunk, buffer);
+    });
+}
+
+// Reads up to size bytes, fewer only at the end of input
+size_t read_block(int fd, char *data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t got = read(fd, data + done, size - done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            throw std::runtime_error(std::string("Read error: ") + strerror(errno));
+        }
+        if (got == 0) {
+            break;
+        }
+        done += got;
+    }
+    return done;
+}
+
+// Renders trace of little-endian 32-bit PCs, one line per PC. Blocks are read
+// in order under a lock and rendered on all cores, each with its own cache.
+void write_trace(Output_pipeline& output, size_t& seq, Loader& elf_src, const Options& options) {
+    Cmd_parser parser(elf_src);
+    parser.annotate_lines(options.annotate_lines);
+    parser.collect_labels();
+
+    int trace_file = options.trace == "-" ? STDIN_FILENO : open(options.trace.c_str(), O_RDONLY);
+    if (trace_file < 0) {
+        throw std::runtime_error("Invalid trace file.");
+    }
+
+    std::mutex input_mutex;
+    bool input_end = false;
+    std::exception_ptr error;
+
+    auto render = [&]() {
+        Trace_cache cache(parser, trace_cache_slots);
+        std::vector<Elf32_Addr> pcs(trace_block_pcs);
+
+        while (true) {
+            // Buffer goes first, so the lowest pending block always has one
+            std::string *buffer = output.acquire();
+            size_t block_seq;
+            size_t count;
+            {
+                std::lock_guard<std::mutex> lock(input_mutex);
+                size_t bytes = 0;
+                if (!input_end) {
+                    try {
+                        bytes = read_block(trace_file, (char*)pcs.data(), pcs.size() * sizeof(Elf32_Addr));
+                        if (bytes % sizeof(Elf32_Addr) != 0) {
+                            throw std::runtime_error("Trace size is not a multiple of 4.");
+                        }
+                    } catch (std::exception&) {
+                        error = std::current_exception();
+                        bytes = 0;
+                    }
+                    input_end = bytes < pcs.size() * sizeof(Elf32_Addr);
+                }
+                if (bytes == 0) {
+                    output.release(buffer);
+                    return;
+                }
+                count = bytes / sizeof(Elf32_Addr);
+                block_seq = seq++;
+            }
+
+            try {
+                for (size_t i = 0; i < count; i++) {
+                    cache.append_line(pcs[i], *buffer);
+                }
+            } catch (...) {
+                // Blocks taken are still submitted, later ones are not read
+                buffer->clear();
+                std::lock_guard<std::mutex> lock(input_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                input_end = true;
+            }
+            output.submit(block_seq, buffer);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < render_threads(); i++) {
+        workers.emplace_back(render);
+    }
+    render();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    if (trace_file != STDIN_FILENO) {
+        close(trace_file);
     }
+    if (options.stats) {
+        print_cache_stats(parser.render_cache_lookups(), parser.render_cache_hits());
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+const char symtab_header[] = "\n\n.symtab\n\nSymbol Value              Size Type     Bind     Vis       Index Name\n";
+
+void append_symbol(Loader& elf_src, size_t i, const Elf32_Sym& symbol, std::string& out) {
+    unsigned char sym_info  = symbol.st_info;
+    unsigned char sym_other = symbol.st_other;
+    Elf32_Addr    sym_value = symbol.st_value;
+    Elf32_Word    sym_size  = symbol.st_size;
+    const char*   sym_type  = elf_src.get_symbol_type(ELF32_ST_TYPE(sym_info));
+    const char*   sym_bind  = elf_src.get_symbol_bind(ELF32_ST_BIND(sym_info));
+    const char*   sym_vis   = elf_src.get_symbol_visibility(ELF32_ST_VISIBILITY(sym_other));
+    std::string   sym_index = elf_src.get_symbol_index(symbol.st_shndx);
+    const char*   sym_name  = elf_src.get_symbol_name(symbol.st_name);
+
+    char fmt_string[128];
+    sprintf(fmt_string, "[%4i] 0x%-15X %5i %-8s %-8s %-8s %6s ",
+            (int)i, sym_value, sym_size, sym_type, sym_bind, sym_vis, sym_index.c_str());
+    out += fmt_string;
+    out += sym_name;
+    out += '\n';
 }
 
-void write_symtab_in_file(FILE *output, Elf_parser& elf_src) {
-    fprintf(output, ".symtab\n");
-    fprintf(output, "\nSymbol Value              Size Type     Bind     Vis       Index Name\n");
+void write_symtab_in_file(Output_pipeline& output, size_t& seq, Loader& elf_src) {
+    std::string *buffer = output.acquire();
+    *buffer += symtab_header;
     std::vector<Elf32_Sym> symtab = elf_src.get_symtab();
 
     for (size_t i = 0; i < symtab.size(); i++) {
-        Elf32_Sym symbol = symtab[i];
-        unsigned char sym_info  = symbol.st_info;
-        unsigned char sym_other = symbol.st_other;
-        Elf32_Addr    sym_value = symbol.st_value;
-        Elf32_Word    sym_size  = symbol.st_size;
-        const char*   sym_type  = elf_src.get_symbol_type(ELF32_ST_TYPE(sym_info));
-        const char*   sym_bind  = elf_src.get_symbol_bind(ELF32_ST_BIND(sym_info));
-        const char*   sym_vis   = elf_src.get_symbol_visibility(ELF32_ST_VISIBILITY(sym_other));
-        std::string   sym_index = elf_src.get_symbol_index(symbol.st_shndx);
-        const char*   sym_name  = elf_src.get_symbol_name(symbol.st_name);
+        append_symbol(elf_src, i, symtab[i], *buffer);
+        if (buffer->size() >= output_buffer_size) {
+            output.submit(seq++, buffer);
+            buffer = output.acquire();
+        }
+    }
+    output.submit(seq++, buffer);
+}
 
-        fprintf(output, "[%4i] 0x%-15X %5i %-8s %-8s %-8s %6s %s\n",
-                (int)i, sym_value, sym_size, sym_type, sym_bind, sym_vis, sym_index.c_str(), sym_name);
+// Whole listing of one object into out, as write_cmds, write_data_sections
+// and write_symtab_in_file would print it; cycle_model is nullptr without --cycles
+void render_object(Loader& elf_src, const Options& options, const Cycle_model *cycle_model, std::string& out,
+                   std::atomic<uint64_t>& cache_lookups, std::atomic<uint64_t>& cache_hits) {
+    Cmd_parser parser(elf_src);
+    parser.annotate_lines(options.annotate_lines);
+    parser.pseudo_instructions(options.pseudo_instructions);
+    parser.set_cycle_model(cycle_model);
+    std::unique_ptr<Line_table> lines;
+    std::unique_ptr<Source_pool> sources;
+    if (options.source_lines) {
+        lines.reset(new Line_table(elf_src));
+        sources.reset(new Source_pool(lines->files()));
+        parser.set_source_lines(lines.get(), sources.get());
+    }
+    parser.collect_labels();
+
+    out += ".text\n";
+    parser.render_lines(0, parser.cmds_count(), out);
+    cache_lookups += parser.render_cache_lookups();
+    cache_hits += parser.render_cache_hits();
+    if (options.dump_data) {
+        Data_dump dump(elf_src);
+        for (size_t chunk = 0; chunk < dump.chunks_count(); chunk++) {
+            dump.render_chunk(chunk, out);
+        }
+    }
+
+    out += symtab_header;
+    std::vector<Elf32_Sym> symtab = elf_src.get_symtab();
+    for (size_t i = 0; i < symtab.size(); i++) {
+        append_symbol(elf_src, i, symtab[i], out);
     }
 }
 
-int main(int argc, char **argv) {
-    if (argc != 3) {
-        std::cerr << "Wrong number of arguments.\n" << std::endl;
-        return 1;
+// Objects of the inputs: whole files and archive members. Archives stay
+// open while their members are processed, other objects are opened by the
+// job which processes them. An input which can't be opened or listed is
+// one object carrying the error, so the other inputs still get listed.
+struct Object_list {
+    struct Object {
+        size_t      input;
+        // Member offset in an archive input
+        size_t      offset;
+        std::string name;
+        std::string error;
+    };
+
+    std::vector<Object> objects;
+    // Open source of every archive and of stdin, nullptr for other inputs
+    std::vector<Input_source*> sources;
+    std::vector<std::unique_ptr<Input_source>> opened_sources;
+    std::vector<int> opened_files;
+
+    ~Object_list() {
+        opened_sources.clear();
+        for (int file : opened_files) {
+            close(file);
+        }
+    }
+};
+
+// Objects of input idx, source is its open source or nullptr.
+// Throws std::runtime_error if the input can't be opened or listed.
+void list_input(Object_list& list, size_t idx, const std::string& input, Input_source *source) {
+    int file = -1;
+    if (source == nullptr) {
+        file = open(input.c_str(), O_RDONLY);
+        if (file < 0) {
+            throw std::runtime_error("Invalid input file " + input + ".");
+        }
+        list.opened_files.push_back(file);
+        list.opened_sources.emplace_back(new Input_source(file));
+        source = list.opened_sources.back().get();
+    }
+    if (!Archive::is_archive(*source)) {
+        // Not needed any more unless it is stdin, which cannot be opened again
+        list.objects.push_back({idx, 0, input, ""});
+        if (file >= 0) {
+            list.opened_sources.pop_back();
+            list.opened_files.pop_back();
+            close(file);
+        }
+        else {
+            list.sources[idx] = source;
+        }
+        return;
+    }
+    Archive archive(*source);
+    for (const Archive::Member& member : archive.members()) {
+        list.objects.push_back({idx, member.offset, input + "(" + member.name + ")", ""});
+    }
+    list.sources[idx] = source;
+}
+
+// first_source is the open source of the first input, nullptr if not opened
+void list_objects(const Options& options, Input_source *first_source, Object_list& list) {
+    list.sources.assign(options.inputs.size(), nullptr);
+    for (size_t i = 0; i < options.inputs.size(); i++) {
+        const std::string& input = options.inputs[i];
+        try {
+            list_input(list, i, input, i == 0 ? first_source : nullptr);
+        } catch (std::exception& e) {
+            list.objects.push_back({i, 0, input, e.what()});
+        }
+    }
+}
+
+// Calls process(loader) with the ELF image of object idx of list
+template <typename Process>
+void process_object(const Object_list& list, size_t idx, Process process) {
+    const Object_list::Object& object = list.objects[idx];
+    if (!object.error.empty()) {
+        throw std::runtime_error(object.error);
     }
+    if (list.sources[object.input] != nullptr) {
+        Elf_parser elf_src(*list.sources[object.input], object.offset);
+        process(elf_src);
+        return;
+    }
+    int file = open(object.name.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Invalid input file.");
+    }
+    try {
+        Input_source source(file);
+        Elf_parser elf_src(source);
+        process(elf_src);
+    } catch (std::exception&) {
+        close(file);
+        throw;
+    }
+    close(file);
+}
+
+// Appends the "<object>:" header of job, the output of process(loader) and
+// the error text instead if it fails
+template <typename Process>
+void render_object_job(const Object_list& list, size_t job, std::string& buffer, Process process) {
+    buffer += job == 0 ? "" : "\n\n";
+    buffer += list.objects[job].name;
+    buffer += ":\n";
+    size_t listing_start = buffer.size();
+    try {
+        process_object(list, job, process);
+    } catch (std::exception& e) {
+        buffer.resize(listing_start);
+        buffer += e.what();
+        buffer += '\n';
+    }
+}
+
+// Lists objects of several inputs or archive members, each under an
+// "<input>:" or "<archive>(<member>):" header. Objects are rendered whole,
+// one per job on all cores; an object which fails gets its error instead.
+void write_objects(Output_pipeline& output, size_t& seq, const Options& options, Input_source *first_source) {
+    Object_list list;
+    list_objects(options, first_source, list);
+    Cycle_model cycle_model;
+    if (!options.cycles.empty()) {
+        cycle_model.load(options.cycles);
+    }
+
+    std::atomic<uint64_t> cache_lookups(0);
+    std::atomic<uint64_t> cache_hits(0);
+    render_jobs(output, seq, list.objects.size(), [&](size_t job, std::string& buffer) {
+        render_object_job(list, job, buffer, [&](Loader& elf_src) {
+            render_object(elf_src, options, options.cycles.empty() ? nullptr : &cycle_model, buffer, cache_lookups, cache_hits);
+        });
+    });
+    if (options.stats) {
+        print_cache_stats(cache_lookups, cache_hits);
+    }
+}
 
-    FILE *input_file = fopen(argv[1], "rb");
-    if (input_file == nullptr) {
-        std::cerr << "Invalid input file.\n";
+// Signatures of functions on threads threads; indexed[i] is 0 for functions
+// too short to fingerprint. Not a std::vector<bool>: threads write their own
+// elements.
+void fingerprint_functions(Loader& elf_src, const std::vector<Cmd_parser::Function_range>& functions,
+                           unsigned threads, std::vector<function_index::Signature>& signatures,
+                           std::vector<char>& indexed) {
+    signatures.resize(functions.size());
+    indexed.assign(functions.size(), 0);
+    const Elf32_Word *text = elf_src.get_text();
+    std::atomic<size_t> next_chunk(0);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto fingerprint = [&]() {
+        try {
+            for (size_t chunk = next_chunk++; chunk * functions_per_chunk < functions.size(); chunk = next_chunk++) {
+                size_t last = std::min((chunk + 1) * functions_per_chunk, functions.size());
+                for (size_t i = chunk * functions_per_chunk; i < last; i++) {
+                    const Cmd_parser::Function_range& function = functions[i];
+                    indexed[i] = function_index::fingerprint(text + function.first, function.last - function.first,
+                                                                   signatures[i]);
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(fingerprint);
+    }
+    fingerprint();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Threads of one object: all cores for a single object, one per object otherwise
+unsigned object_threads(const Object_list& list) {
+    return std::max<unsigned>(1, render_threads() / std::max<size_t>(1, list.objects.size()));
+}
+
+// Index of functions of all objects of the inputs, objects are fingerprinted
+// on all cores. The output gets the number of functions of every object.
+void write_function_index(Output_pipeline& output, size_t& seq, const Options& options, Input_source *first_source) {
+    struct Entry {
+        std::string function;
+        Elf32_Addr  addr;
+        size_t      cmds;
+        function_index::Signature signature;
+    };
+    Object_list list;
+    list_objects(options, first_source, list);
+    std::vector<std::vector<Entry>> entries(list.objects.size());
+
+    render_jobs(output, seq, list.objects.size(), [&](size_t job, std::string& buffer) {
+        render_object_job(list, job, buffer, [&](Loader& elf_src) {
+            Cmd_parser parser(elf_src);
+            std::vector<Cmd_parser::Function_range> functions = parser.functions();
+            std::vector<function_index::Signature> signatures;
+            std::vector<char> indexed;
+            fingerprint_functions(elf_src, functions, object_threads(list), signatures, indexed);
+            for (size_t i = 0; i < functions.size(); i++) {
+                if (indexed[i]) {
+                    const Cmd_parser::Function_range& function = functions[i];
+                    entries[job].push_back({function.name, function.start, function.last - function.first, signatures[i]});
+                }
+            }
+            char fmt_string[64];
+            sprintf(fmt_string, "%zu functions indexed\n", entries[job].size());
+            buffer += fmt_string;
+        });
+    });
+
+    Function_index_builder builder;
+    for (size_t i = 0; i < list.objects.size(); i++) {
+        for (const Entry& entry : entries[i]) {
+            builder.add(list.objects[i].name, entry.function, entry.addr, entry.cmds, entry.signature);
+        }
+    }
+    builder.write(options.build_index);
+}
+
+// Functions of the index similar to functions of the inputs, --function
+// picks the functions to look for
+void write_similar_functions(Output_pipeline& output, size_t& seq, const Options& options, Input_source *first_source) {
+    Function_index index(options.query_index);
+    Object_list list;
+    list_objects(options, first_source, list);
+
+    render_jobs(output, seq, list.objects.size(), [&](size_t job, std::string& buffer) {
+        render_object_job(list, job, buffer, [&](Loader& elf_src) {
+            Cmd_parser parser(elf_src);
+            std::vector<Cmd_parser::Function_range> functions = parser.functions();
+            if (!options.functions.empty()) {
+                functions.erase(std::remove_if(functions.begin(), functions.end(), [&](const Cmd_parser::Function_range& function) {
+                    return std::find(options.functions.begin(), options.functions.end(), function.name) == options.functions.end();
+                }), functions.end());
+            }
+            std::vector<function_index::Signature> signatures;
+            std::vector<char> indexed;
+            fingerprint_functions(elf_src, functions, object_threads(list), signatures, indexed);
+
+            char fmt_string[64];
+            for (size_t i = 0; i < functions.size(); i++) {
+                sprintf(fmt_string, "\n%08x \t<", functions[i].start);
+                buffer += fmt_string;
+                buffer += functions[i].name;
+                buffer += ">:\n";
+                if (!indexed[i]) {
+                    buffer += "   too short\n";
+                    continue;
+                }
+                std::vector<Function_index::Match> matches = index.query(signatures[i], options.min_similarity,
+                                                                         max_similar_functions);
+                if (matches.empty()) {
+                    buffer += "   -\n";
+                }
+                for (const Function_index::Match& match : matches) {
+                    sprintf(fmt_string, "   %5.1f%%  %08x %5zu  ", 100.0 * match.similarity, match.addr, match.cmds);
+                    buffer += fmt_string;
+                    buffer += match.object;
+                    buffer += " <";
+                    buffer += match.function;
+                    buffer += ">\n";
+                }
+            }
+        });
+    });
+}
+
+// Loader of the input format. HEX starts with ':', anything else is taken
+// for ELF unless the format is given.
+std::unique_ptr<Loader> open_loader(Input_source& source, const Options& options) {
+    std::string format = options.format;
+    if (format.empty()) {
+        format = source.read(0, 1)[0] == ':' ? "hex" : "elf";
+    }
+
+    if (format == "elf") {
+        return std::unique_ptr<Loader>(new Elf_parser(source));
+    }
+    std::unique_ptr<Image_loader> image;
+    if (format == "hex") {
+        image.reset(new Hex_loader(source));
+    }
+    else {
+        image.reset(new Bin_loader(source, options.base_addr));
+    }
+    if (!options.map.empty()) {
+        image->load_map(options.map);
+    }
+    return std::unique_ptr<Loader>(image.release());
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (std::exception &e) {
+        std::cerr << e.what() << "\n" << usage();
         return 1;
     }
 
-    FILE *output_file = fopen(argv[2], "w");
-    if (output_file == nullptr) {
+    int output_file = options.output == "-" ? STDOUT_FILENO : open(options.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_file < 0) {
         std::cerr << "Invalid output file.\n" << std::endl;
         return 1;
     }
 
+    // "-" stands for stdin and stdout
+    FILE *input_file = nullptr;
+    if (options.inputs.size() == 1) {
+        const std::string& input = options.inputs[0];
+        input_file = input == "-" ? stdin : fopen(input.c_str(), "rb");
+        if (input_file == nullptr) {
+            std::cerr << "Invalid input file.\n";
+            return 1;
+        }
+    }
+
     try {
-        Elf_parser parser = Elf_parser(input_file);
-        write_cmds(output_file, parser);
-        fprintf(output_file, "\n\n");
-        write_symtab_in_file(output_file, parser);
+        // Two buffers per render thread keep renderers busy while one is written
+        Output_pipeline output(output_file, 2 * render_threads() + 2, output_buffer_size);
+        size_t seq = 0;
+        if (input_file == nullptr && !options.build_index.empty()) {
+            write_function_index(output, seq, options, nullptr);
+        }
+        else if (input_file == nullptr && !options.query_index.empty()) {
+            write_similar_functions(output, seq, options, nullptr);
+        }
+        else if (input_file == nullptr) {
+            write_objects(output, seq, options, nullptr);
+        }
+        else {
+            Input_source source(fileno(input_file));
+            if (!options.build_index.empty()) {
+                write_function_index(output, seq, options, &source);
+            }
+            else if (!options.query_index.empty()) {
+                write_similar_functions(output, seq, options, &source);
+            }
+            else if ((options.format.empty() || options.format == "elf") && Archive::is_archive(source)) {
+                check_several_objects(options);
+                write_objects(output, seq, options, &source);
+            }
+            else {
+                std::unique_ptr<Loader> loader = open_loader(source, options);
+                Loader& parser = *loader;
+                if (!options.trace.empty()) {
+                    write_trace(output, seq, parser, options);
+                }
+                else if (options.register_usage) {
+                    write_register_usage(output, seq, parser);
+                }
+                else {
+                    write_cmds(output, seq, parser, options);
+                    if (options.dump_data) {
+                        write_data_sections(output, seq, parser);
+                    }
+                    // Filtered listings show only the commands asked for
+                    bool filtered = !options.functions.empty() || options.start_address != 0 ||
+                                    options.stop_address != UINT32_MAX || options.top_functions != 0;
+                    if (!filtered) {
+                        write_symtab_in_file(output, seq, parser);
+                    }
+                }
+            }
+        }
+        output.finish();
     } catch (std::exception &e) {
         std::cout << std::string(e.what()) << std::endl;
     }
 
+    if (input_file != nullptr && input_file != stdin) {
+        fclose(input_file);
+    }
+    if (output_file != STDOUT_FILENO) {
+        close(output_file);
+    }
     return 0;
-}
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+# Data sections for --dump-data:
+#   llvm-mc -triple=riscv32 -filetype=obj test_data.s -o test_data.o
+#   ld.lld test_data.o -o test_data_elf
+.text
+.globl _start
+.type _start,@function
+_start:
+  lui a0, %hi(table)
+  lw a0, %lo(table)(a0)
+  ret
+.size _start, .-_start
+
+.section .rodata
+.type msg,@object
+msg: .asciz "Hello, data dump!\n\x01\xff"
+.size msg, .-msg
+.p2align 2
+.type table,@object
+table: .word 1,2,3,4,5,6,7,8,0xdeadbeef
+.size table, .-table
+
+.data
+.type counter,@object
+counter: .word 42
+.size counter, 4
+.space 100, 0x41
+
+.bss
+buf: .space 64
@@ -0,0 +1,23 @@
+# Relocatable object whose .data and .text both start at 0: tbl comes
+# first in the symbol table, so it must not shadow f.
+# llvm-mc -triple=riscv32 -mattr=+m -filetype=obj test_rel.s -o test_rel.o
+.data
+.globl tbl
+.type tbl,@object
+tbl:
+ .word 1,2,3,4,5,6,7,8,9,10,11,12,13,14
+.size tbl,.-tbl
+
+.text
+.globl f
+.type f,@function
+f:
+ lui a0, %hi(tbl)
+ addi a0, a0, %lo(tbl)
+1: auipc a1, %pcrel_hi(tbl)
+ addi a1, a1, %pcrel_lo(1b)
+ lw a2, 0(a0)
+ beq a2, zero, 2f
+ add a0, a0, a1
+2: ret
+.size f,.-f
@@ -0,0 +1,533 @@
+// Exhaustive sweep of the 32-bit encoding space through Cmd_parser.
+//
+// Every word is decoded and checked against three invariants:
+//   1. the decoder returns a non-empty mnemonic for every input;
+//   2. the mnemonic equals the one given by the reference mask/match table
+//      below, written from the ISA manual apart from isa_table;
+//   3. known encodings round-trip: operands printed by the decoder are
+//      parsed back with the reference operand layout, re-encoded and
+//      compared with the original word.
+//
+// Usage: decode_sweep [--threads N] [--start WORD] [--count N]
+
+#include "Cmd_parser.h"
+#include "Isa.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Reference_cmd {
+    const char *name;
+    Elf32_Word mask;
+    Elf32_Word match;
+    // Layout of the printed operands in the notation of Isa.h
+    const char *operands;
+    // aq and rl bits are printed as a mnemonic suffix
+    bool aq_rl;
+};
+
+// Masks by format, as in the opcode map of the ISA manual
+#define OPCODE  0x0000007f  // U and J types
+#define FUNCT3  0x0000707f  // I, S and B types
+#define FUNCT7  0xfe00707f  // R type
+#define FMT_RM  0xfe00007f  // R type with a rounding mode
+#define RS2_RM  0xfff0007f  // R type with rs2 and a rounding mode fixed
+#define RS2     0xfff0707f  // R type with rs2 fixed
+#define FMT_R4  0x0600007f  // R4 type
+#define AMO     0xf800707f  // R type with aq and rl free
+
+// RV32IMAFD, Zicsr and Zifencei encodings.
+// More specific entries go first: the first matching one wins.
+static const Reference_cmd reference[] = {
+    // RV32I
+    {"lui",       OPCODE,     0x00000037, "d, u",        false},
+    {"auipc",     OPCODE,     0x00000017, "d, u",        false},
+    {"jal",       OPCODE,     0x0000006f, "d, a",        false},
+    {"jalr",      FUNCT3,     0x00000067, "d, j(s)",     false},
+    {"beq",       FUNCT3,     0x00000063, "s, t, p",     false},
+    {"bne",       FUNCT3,     0x00001063, "s, t, p",     false},
+    {"blt",       FUNCT3,     0x00004063, "s, t, p",     false},
+    {"bge",       FUNCT3,     0x00005063, "s, t, p",     false},
+    {"bltu",      FUNCT3,     0x00006063, "s, t, p",     false},
+    {"bgeu",      FUNCT3,     0x00007063, "s, t, p",     false},
+    {"lb",        FUNCT3,     0x00000003, "d, j(s)",     false},
+    {"lh",        FUNCT3,     0x00001003, "d, j(s)",     false},
+    {"lw",        FUNCT3,     0x00002003, "d, j(s)",     false},
+    {"lbu",       FUNCT3,     0x00004003, "d, j(s)",     false},
+    {"lhu",       FUNCT3,     0x00005003, "d, j(s)",     false},
+    {"sb",        FUNCT3,     0x00000023, "t, q(s)",     false},
+    {"sh",        FUNCT3,     0x00001023, "t, q(s)",     false},
+    {"sw",        FUNCT3,     0x00002023, "t, q(s)",     false},
+    {"addi",      FUNCT3,     0x00000013, "d, s, j",     false},
+    {"slti",      FUNCT3,     0x00002013, "d, s, j",     false},
+    {"sltiu",     FUNCT3,     0x00003013, "d, s, j",     false},
+    {"xori",      FUNCT3,     0x00004013, "d, s, j",     false},
+    {"ori",       FUNCT3,     0x00006013, "d, s, j",     false},
+    {"andi",      FUNCT3,     0x00007013, "d, s, j",     false},
+    {"slli",      FUNCT7,     0x00001013, "d, s, >",     false},
+    {"srli",      FUNCT7,     0x00005013, "d, s, >",     false},
+    {"srai",      FUNCT7,     0x40005013, "d, s, >",     false},
+    {"add",       FUNCT7,     0x00000033, "d, s, t",     false},
+    {"sub",       FUNCT7,     0x40000033, "d, s, t",     false},
+    {"sll",       FUNCT7,     0x00001033, "d, s, t",     false},
+    {"slt",       FUNCT7,     0x00002033, "d, s, t",     false},
+    {"sltu",      FUNCT7,     0x00003033, "d, s, t",     false},
+    {"xor",       FUNCT7,     0x00004033, "d, s, t",     false},
+    {"srl",       FUNCT7,     0x00005033, "d, s, t",     false},
+    {"sra",       FUNCT7,     0x40005033, "d, s, t",     false},
+    {"or",        FUNCT7,     0x00006033, "d, s, t",     false},
+    {"and",       FUNCT7,     0x00007033, "d, s, t",     false},
+    {"pause",     0xffffffff, 0x0100000f, "",            false},
+    {"fence.tso", 0xfff0707f, 0x8330000f, "",            false},
+    {"fence",     FUNCT3,     0x0000000f, "P, Q",        false},
+    {"ecall",     0xffffffff, 0x00000073, "",            false},
+    {"ebreak",    0xffffffff, 0x00100073, "",            false},
+
+    // RV32M: funct7 1 of OP
+    {"mul",       FUNCT7,     0x02000033, "d, s, t",     false},
+    {"mulh",      FUNCT7,     0x02001033, "d, s, t",     false},
+    {"mulhsu",    FUNCT7,     0x02002033, "d, s, t",     false},
+    {"mulhu",     FUNCT7,     0x02003033, "d, s, t",     false},
+    {"div",       FUNCT7,     0x02004033, "d, s, t",     false},
+    {"divu",      FUNCT7,     0x02005033, "d, s, t",     false},
+    {"rem",       FUNCT7,     0x02006033, "d, s, t",     false},
+    {"remu",      FUNCT7,     0x02007033, "d, s, t",     false},
+
+    // RV32A: AMO opcode, funct3 2, funct5 in bits 31..27
+    {"lr.w",      AMO | 0x01f00000, 0x1000202f, "d, (s)", true},
+    {"sc.w",      AMO,        0x1800202f, "d, t, (s)",   true},
+    {"amoswap.w", AMO,        0x0800202f, "d, t, (s)",   true},
+    {"amoadd.w",  AMO,        0x0000202f, "d, t, (s)",   true},
+    {"amoxor.w",  AMO,        0x2000202f, "d, t, (s)",   true},
+    {"amoand.w",  AMO,        0x6000202f, "d, t, (s)",   true},
+    {"amoor.w",   AMO,        0x4000202f, "d, t, (s)",   true},
+    {"amomin.w",  AMO,        0x8000202f, "d, t, (s)",   true},
+    {"amomax.w",  AMO,        0xa000202f, "d, t, (s)",   true},
+    {"amominu.w", AMO,        0xc000202f, "d, t, (s)",   true},
+    {"amomaxu.w", AMO,        0xe000202f, "d, t, (s)",   true},
+
+    // RV32F: fmt 0 in bits 26..25
+    {"flw",       FUNCT3,     0x00002007, "D, j(s)",     false},
+    {"fsw",       FUNCT3,     0x00002027, "T, q(s)",     false},
+    {"fmadd.s",   FMT_R4,     0x00000043, "D, S, T, Rm", false},
+    {"fmsub.s",   FMT_R4,     0x00000047, "D, S, T, Rm", false},
+    {"fnmsub.s",  FMT_R4,     0x0000004b, "D, S, T, Rm", false},
+    {"fnmadd.s",  FMT_R4,     0x0000004f, "D, S, T, Rm", false},
+    {"fadd.s",    FMT_RM,     0x00000053, "D, S, Tm",    false},
+    {"fsub.s",    FMT_RM,     0x08000053, "D, S, Tm",    false},
+    {"fmul.s",    FMT_RM,     0x10000053, "D, S, Tm",    false},
+    {"fdiv.s",    FMT_RM,     0x18000053, "D, S, Tm",    false},
+    {"fsqrt.s",   RS2_RM,     0x58000053, "D, Sm",       false},
+    {"fsgnj.s",   FUNCT7,     0x20000053, "D, S, T",     false},
+    {"fsgnjn.s",  FUNCT7,     0x20001053, "D, S, T",     false},
+    {"fsgnjx.s",  FUNCT7,     0x20002053, "D, S, T",     false},
+    {"fmin.s",    FUNCT7,     0x28000053, "D, S, T",     false},
+    {"fmax.s",    FUNCT7,     0x28001053, "D, S, T",     false},
+    {"fcvt.w.s",  RS2_RM,     0xc0000053, "d, Sm",       false},
+    {"fcvt.wu.s", RS2_RM,     0xc0100053, "d, Sm",       false},
+    {"fmv.x.w",   RS2,        0xe0000053, "d, S",        false},
+    {"feq.s",     FUNCT7,     0xa0002053, "d, S, T",     false},
+    {"flt.s",     FUNCT7,     0xa0001053, "d, S, T",     false},
+    {"fle.s",     FUNCT7,     0xa0000053, "d, S, T",     false},
+    {"fclass.s",  RS2,        0xe0001053, "d, S",        false},
+    {"fcvt.s.w",  RS2_RM,     0xd0000053, "D, sm",       false},
+    {"fcvt.s.wu", RS2_RM,     0xd0100053, "D, sm",       false},
+    {"fmv.w.x",   RS2,        0xf0000053, "D, s",        false},
+
+    // RV32D: fmt 1 in bits 26..25
+    {"fld",       FUNCT3,     0x00003007, "D, j(s)",     false},
+    {"fsd",       FUNCT3,     0x00003027, "T, q(s)",     false},
+    {"fmadd.d",   FMT_R4,     0x02000043, "D, S, T, Rm", false},
+    {"fmsub.d",   FMT_R4,     0x02000047, "D, S, T, Rm", false},
+    {"fnmsub.d",  FMT_R4,     0x0200004b, "D, S, T, Rm", false},
+    {"fnmadd.d",  FMT_R4,     0x0200004f, "D, S, T, Rm", false},
+    {"fadd.d",    FMT_RM,     0x02000053, "D, S, Tm",    false},
+    {"fsub.d",    FMT_RM,     0x0a000053, "D, S, Tm",    false},
+    {"fmul.d",    FMT_RM,     0x12000053, "D, S, Tm",    false},
+    {"fdiv.d",    FMT_RM,     0x1a000053, "D, S, Tm",    false},
+    {"fsqrt.d",   RS2_RM,     0x5a000053, "D, Sm",       false},
+    {"fsgnj.d",   FUNCT7,     0x22000053, "D, S, T",     false},
+    {"fsgnjn.d",  FUNCT7,     0x22001053, "D, S, T",     false},
+    {"fsgnjx.d",  FUNCT7,     0x22002053, "D, S, T",     false},
+    {"fmin.d",    FUNCT7,     0x2a000053, "D, S, T",     false},
+    {"fmax.d",    FUNCT7,     0x2a001053, "D, S, T",     false},
+    {"fcvt.s.d",  RS2_RM,     0x40100053, "D, Sm",       false},
+    // Widening is exact, the rounding mode is not printed
+    {"fcvt.d.s",  RS2_RM,     0x42000053, "D, S",        false},
+    {"feq.d",     FUNCT7,     0xa2002053, "d, S, T",     false},
+    {"flt.d",     FUNCT7,     0xa2001053, "d, S, T",     false},
+    {"fle.d",     FUNCT7,     0xa2000053, "d, S, T",     false},
+    {"fclass.d",  RS2,        0xe2001053, "d, S",        false},
+    {"fcvt.w.d",  RS2_RM,     0xc2000053, "d, Sm",       false},
+    {"fcvt.wu.d", RS2_RM,     0xc2100053, "d, Sm",       false},
+    {"fcvt.d.w",  RS2_RM,     0xd2000053, "D, s",        false},
+    {"fcvt.d.wu", RS2_RM,     0xd2100053, "D, s",        false},
+
+    // Zicsr: SYSTEM opcode, funct3 other than 0 and 4
+    {"csrrw",     FUNCT3,     0x00001073, "d, E, s",     false},
+    {"csrrs",     FUNCT3,     0x00002073, "d, E, s",     false},
+    {"csrrc",     FUNCT3,     0x00003073, "d, E, s",     false},
+    {"csrrwi",    FUNCT3,     0x00005073, "d, E, Z",     false},
+    {"csrrsi",    FUNCT3,     0x00006073, "d, E, Z",     false},
+    {"csrrci",    FUNCT3,     0x00007073, "d, E, Z",     false},
+
+    // Zifencei
+    {"fence.i",   FUNCT3,     0x0000100f, "",            false},
+};
+
+// Rounding modes of the F and D extensions, 7 is the dynamic one
+static const char *rounding_modes[8] = {
+    "rne", "rtz", "rdn", "rup", "rmm", "rm5", "rm6", "dyn"
+};
+static const Elf32_Word rm_dynamic = 7;
+
+static const char *register_names[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+    "s0",   "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6",   "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+    "s8",   "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+static const char *fp_register_names[32] = {
+    "ft0", "ft1", "ft2",  "ft3",  "ft4", "ft5", "ft6",  "ft7",
+    "fs0", "fs1", "fa0",  "fa1",  "fa2", "fa3", "fa4",  "fa5",
+    "fa6", "fa7", "fs2",  "fs3",  "fs4", "fs5", "fs6",  "fs7",
+    "fs8", "fs9", "fs10", "fs11", "ft8", "ft9", "ft10", "ft11"
+};
+
+static const Reference_cmd *find_reference(Elf32_Word cmd) {
+    for (const Reference_cmd& ref : reference) {
+        if ((cmd & ref.mask) == ref.match) {
+            return &ref;
+        }
+    }
+    return nullptr;
+}
+
+// Minimal cursor over the operand text printed by the decoder
+struct Operand_reader {
+    const char *pos;
+    bool ok;
+
+    void expect(const char *literal) {
+        size_t len = strlen(literal);
+        if (ok && strncmp(pos, literal, len) == 0) {
+            pos += len;
+        } else {
+            ok = false;
+        }
+    }
+
+    // Index of the longest name at pos, so that "s10" is not read as "s1"
+    Elf32_Word name(const char *const *names, size_t count) {
+        if (!ok) {
+            return 0;
+        }
+        int best = -1;
+        size_t best_len = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t len = strlen(names[i]);
+            if (len > best_len && strncmp(pos, names[i], len) == 0) {
+                best = i;
+                best_len = len;
+            }
+        }
+        if (best < 0) {
+            ok = false;
+            return 0;
+        }
+        pos += best_len;
+        return best;
+    }
+
+    Elf32_Word number(int base) {
+        if (!ok) {
+            return 0;
+        }
+        char *end;
+        long long value = strtoll(pos, &end, base);
+        if (end == pos) {
+            ok = false;
+        }
+        pos = end;
+        return (Elf32_Word)value;
+    }
+
+    // CSR names are spelling only, so they come from Isa.h
+    Elf32_Word csr() {
+        for (const Isa_csr& known : isa_csr_names) {
+            size_t len = strlen(known.name);
+            if (strncmp(pos, known.name, len) == 0 && (pos[len] == ',' || pos[len] == '\0')) {
+                pos += len;
+                return known.number;
+            }
+        }
+        expect("0x");
+        return number(16);
+    }
+
+    Elf32_Word fence_set() {
+        Elf32_Word set = 0;
+        const char letters[] = "iorw";
+        for (int bit = 3; bit >= 0; bit--) {
+            if (*pos == letters[3 - bit]) {
+                set |= 1u << bit;
+                pos++;
+            }
+        }
+        return set;
+    }
+};
+
+static Elf32_Word encode_i_imm(Elf32_Word imm) {
+    return (imm & 0xfff) << 20;
+}
+
+static Elf32_Word encode_s_imm(Elf32_Word imm) {
+    return ((imm & 0x1f) << 7) | (((imm >> 5) & 0x7f) << 25);
+}
+
+static Elf32_Word encode_b_imm(Elf32_Word imm) {
+    return (((imm >> 11) & 1) << 7) | (((imm >> 1) & 0xf) << 8) |
+           (((imm >> 5) & 0x3f) << 25) | (((imm >> 12) & 1) << 31);
+}
+
+static Elf32_Word encode_j_imm(Elf32_Word imm) {
+    return (((imm >> 12) & 0xff) << 12) | (((imm >> 11) & 1) << 20) |
+           (((imm >> 1) & 0x3ff) << 21) | (((imm >> 20) & 1) << 31);
+}
+
+// Re-encodes the operand text of ref command located at pc.
+// Bits which are neither fixed by ref nor printed as operands are not compared.
+// Returns false if the text can not be parsed or does not give back cmd.
+static bool round_trip(const Reference_cmd& ref, const char *operands, Elf32_Word cmd, Elf32_Addr pc) {
+    Operand_reader in = {operands, true};
+    Elf32_Word encoded = ref.match;
+    Elf32_Word checked = ref.mask;
+
+    for (const char *op = ref.operands; *op != '\0' && in.ok; op++) {
+        switch (*op) {
+            case 'd':
+                encoded |= in.name(register_names, 32) << 7;
+                checked |= 0x00000f80;
+                break;
+            case 's':
+                encoded |= in.name(register_names, 32) << 15;
+                checked |= 0x000f8000;
+                break;
+            case 't':
+                encoded |= in.name(register_names, 32) << 20;
+                checked |= 0x01f00000;
+                break;
+            case 'D':
+                encoded |= in.name(fp_register_names, 32) << 7;
+                checked |= 0x00000f80;
+                break;
+            case 'S':
+                encoded |= in.name(fp_register_names, 32) << 15;
+                checked |= 0x000f8000;
+                break;
+            case 'T':
+                encoded |= in.name(fp_register_names, 32) << 20;
+                checked |= 0x01f00000;
+                break;
+            case 'R':
+                encoded |= in.name(fp_register_names, 32) << 27;
+                checked |= 0xf8000000;
+                break;
+            case 'j':
+                encoded |= encode_i_imm(in.number(10));
+                checked |= 0xfff00000;
+                break;
+            case 'q':
+                encoded |= encode_s_imm(in.number(10));
+                checked |= 0xfe000f80;
+                break;
+            case '>':
+                encoded |= (in.number(10) & 0x1f) << 20;
+                checked |= 0x01f00000;
+                break;
+            case 'Z':
+                encoded |= (in.number(10) & 0x1f) << 15;
+                checked |= 0x000f8000;
+                break;
+            case 'u':
+                in.expect("0x");
+                encoded |= in.number(16) << 12;
+                checked |= 0xfffff000;
+                break;
+            case 'p':
+                in.expect("0x");
+                encoded |= encode_b_imm(in.number(16) - pc);
+                in.expect(", <");
+                checked |= 0xfe000f80;
+                break;
+            case 'a':
+                in.expect("0x");
+                encoded |= encode_j_imm(in.number(16) - pc);
+                in.expect(" <");
+                checked |= 0xfffff000;
+                break;
+            case 'E':
+                encoded |= (in.csr() & 0xfff) << 20;
+                checked |= 0xfff00000;
+                break;
+            case 'P':
+                encoded |= in.fence_set() << 24;
+                checked |= 0x0f000000;
+                break;
+            case 'Q':
+                encoded |= in.fence_set() << 20;
+                checked |= 0x00f00000;
+                break;
+            case 'm':
+                if (*in.pos == ',') {
+                    in.expect(", ");
+                    encoded |= in.name(rounding_modes, 8) << 12;
+                } else {
+                    encoded |= rm_dynamic << 12;
+                }
+                checked |= 0x00007000;
+                break;
+            default: {
+                char literal[2] = {*op, '\0'};
+                in.expect(literal);
+            }
+        }
+    }
+    // Operands of a branch or jal end with a label name
+    bool has_label = strchr(ref.operands, 'p') != nullptr || strchr(ref.operands, 'a') != nullptr;
+    return in.ok && (has_label || *in.pos == '\0') && ((encoded ^ cmd) & checked) == 0;
+}
+
+struct Sweep_stats {
+    uint64_t decoded = 0;
+    uint64_t valid = 0;
+    uint64_t failures = 0;
+};
+
+static std::mutex report_mutex;
+static const uint64_t max_reported_failures = 20;
+static std::atomic<uint64_t> reported_failures(0);
+
+static void report_failure(Elf32_Word cmd, const char *what, const std::string& text) {
+    if (reported_failures++ >= max_reported_failures) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(report_mutex);
+    fprintf(stderr, "%08x: %s: '%s'\n", cmd, what, text.c_str());
+}
+
+static void check_cmd(Cmd_parser& parser, Elf32_Word cmd, Elf32_Addr pc, Sweep_stats& stats) {
+    std::string text = parser.parse_cmd(cmd, pc);
+    stats.decoded++;
+
+    // Split "%7s\t<operands>" into mnemonic and operands
+    size_t name_start = text.find_first_not_of(' ');
+    if (name_start == std::string::npos) {
+        stats.failures++;
+        report_failure(cmd, "empty result", text);
+        return;
+    }
+    size_t tab = text.find('\t', name_start);
+    std::string name = text.substr(name_start, tab == std::string::npos ? std::string::npos : tab - name_start);
+    const char *operands = tab == std::string::npos ? "" : text.c_str() + tab + 1;
+
+    const Reference_cmd *ref = find_reference(cmd);
+    std::string expected = ref ? ref->name : "invalid_instruction";
+    if (ref != nullptr && ref->aq_rl) {
+        static const char *aq_rl_suffixes[4] = {"", ".rl", ".aq", ".aqrl"};
+        expected += aq_rl_suffixes[(cmd >> 25) & 0x3];
+    }
+    if (name != expected) {
+        stats.failures++;
+        report_failure(cmd, ("expected " + expected).c_str(), text);
+        return;
+    }
+    if (ref == nullptr) {
+        return;
+    }
+    stats.valid++;
+    if (!round_trip(*ref, operands, cmd, pc)) {
+        stats.failures++;
+        report_failure(cmd, "round trip mismatch", text);
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = std::thread::hardware_concurrency();
+    uint64_t start = 0;
+    uint64_t count = 1ull << 32;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--start") == 0 && i + 1 < argc) {
+            start = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = strtoull(argv[++i], nullptr, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--threads N] [--start WORD] [--count N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (start > (1ull << 32) || count > (1ull << 32) - start) {
+        fprintf(stderr, "Range is out of the 32-bit encoding space.\n");
+        return 1;
+    }
+
+    // Words are handed out in chunks. Every chunk gets a fresh parser,
+    // so generated branch labels do not pile up over the sweep.
+    const uint64_t chunk_size = 1 << 20;
+    const uint64_t chunks = (count + chunk_size - 1) / chunk_size;
+    const Elf32_Addr pc = 0x10000;
+    std::atomic<uint64_t> next_chunk(0);
+    std::vector<Sweep_stats> stats(threads);
+    std::vector<double> busy_seconds(threads);
+    std::vector<std::thread> workers;
+
+    auto started = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            auto thread_started = std::chrono::steady_clock::now();
+            for (uint64_t chunk = next_chunk++; chunk < chunks; chunk = next_chunk++) {
+                Cmd_parser parser;
+                uint64_t first = start + chunk * chunk_size;
+                uint64_t last = std::min(first + chunk_size, start + count);
+                for (uint64_t cmd = first; cmd < last; cmd++) {
+                    check_cmd(parser, (Elf32_Word)cmd, pc, stats[t]);
+                }
+            }
+            busy_seconds[t] = std::chrono::duration<double>(std::chrono::steady_clock::now() - thread_started).count();
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    Sweep_stats total;
+    for (unsigned t = 0; t < threads; t++) {
+        total.decoded += stats[t].decoded;
+        total.valid += stats[t].valid;
+        total.failures += stats[t].failures;
+        printf("thread %2u: %12llu words, %8.2f Mwords/s\n", t, (unsigned long long)stats[t].decoded,
+               busy_seconds[t] > 0 ? stats[t].decoded / busy_seconds[t] / 1e6 : 0.0);
+    }
+    printf("decoded:  %llu words (%llu valid, %llu invalid)\n", (unsigned long long)total.decoded,
+           (unsigned long long)total.valid, (unsigned long long)(total.decoded - total.valid));
+    printf("failures: %llu\n", (unsigned long long)total.failures);
+    printf("time:     %.2f s, %.2f Mwords/s on %u threads\n", seconds,
+           seconds > 0 ? total.decoded / seconds / 1e6 : 0.0, threads);
+
+    return total.failures == 0 ? 0 : 1;
+}